@@ -26,18 +26,152 @@
 #define MAX_SENSOR_INTERVAL 1800
 #define MIN_SENSOR_INTERVAL 10
 #define ONE_DAY 86400000UL
+// Readings kept per sensor between logs. Must cover logInterval / sensorReadInterval
+// plus slack for a failed send; override from build flags for unusual intervals.
+#ifndef LOGGER_SENSOR_BUFFER_SIZE
+#define LOGGER_SENSOR_BUFFER_SIZE 64
+#endif
+// Spooled records replayed per drain attempt; bounds per-tick flash I/O
+#ifndef LOGGER_SPOOL_DRAIN_RECORDS
+#define LOGGER_SPOOL_DRAIN_RECORDS 32
+#endif
+#define LOGGER_SPOOL_DRAIN_INTERVAL 10
+// Times a firmware download may resume (HTTP Range) before giving up
+#define LOGGER_OTA_RESUMES 8
+// Abort a firmware download once the stream stays silent this long
+#define LOGGER_OTA_STALL_MS 10000
+// Async transmission task (see beginAsync)
+#define LOGGER_TX_QUEUE_LENGTH 4
+#define LOGGER_TX_RETRIES 3
+#define LOGGER_TX_BACKOFF_MS 250
+// Scheduled retries back off exponentially (base << attempt) with
+// random jitter; a batch in flight longer than the cap is given up on
+// and spooled or dropped, so a dead link cannot pin a payload forever
+#ifndef LOGGER_RETRY_BASE_MS
+#define LOGGER_RETRY_BASE_MS 250
+#endif
+#ifndef LOGGER_INFLIGHT_MAX_MS
+#define LOGGER_INFLIGHT_MAX_MS 30000
+#endif
+// Consecutive failed batches double the effective log interval, up to
+// this multiplier; a delivered batch resets it
+#ifndef LOGGER_INTERVAL_BACKOFF_MAX
+#define LOGGER_INTERVAL_BACKOFF_MAX 16
+#endif
+// Initial capacity reserved for the serialized payload buffer; the
+// buffer regrows to the largest batch seen (high-water mark) so steady
+// state serializes without reallocating
+#ifndef LOGGER_PAYLOAD_RESERVE
+#define LOGGER_PAYLOAD_RESERVE 1024
+#endif
+// Additional log endpoints a batch can be mirrored to (see addEndpoint)
+#define LOGGER_MAX_ENDPOINTS 4
+// Payloads below this stay uncompressed; deflate overhead beats the
+// saving on tiny bodies (see setCompression)
+#ifndef LOGGER_COMPRESS_MIN_BYTES
+#define LOGGER_COMPRESS_MIN_BYTES 512
+#endif
+// How long to let background SNTP answer before paying for the HTTP
+// /time fallback
+#define LOGGER_SNTP_GRACE_MS 10000
+// Sanity floor for epoch values coming from SNTP (2020-09-13)
+#define LOGGER_EPOCH_VALID 1600000000ul
 #define LOGGER_H
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
-#include <HTTPUpdate.h>
 #include <WiFiClientSecure.h>
+// LOGGER_NATIVE builds run on the host (pio test -e native) against the
+// mock headers in test/mocks; the subsystems that need real silicon -
+// OTA partitions, deep sleep, LittleFS, FreeRTOS tasks - compile out.
+#ifndef LOGGER_NATIVE
+#include <Update.h>
+#include <esp_sleep.h>
+#include <Preferences.h>
+#endif
+#ifdef LOGGER_ENABLE_DEFLATE
+#include <miniz.h>
+#endif
+#include "LoggerSpool.h"
 class Sensor;
 template <int NumSensors>
 class ESPLogger;
 
-class Sensor
+// Readings carried across deep sleep in RTC slow memory (~1 KB at the
+// default; RTC RAM has 8 KB total). Overflow spills to the flash spool.
+#ifndef LOGGER_RTC_READINGS
+#define LOGGER_RTC_READINGS 120
+#endif
+#define LOGGER_RTC_MAGIC 0x4C4F4752UL // "LOGR"
+
+// NVS namespace used for state that must survive power loss (currently
+// the status-payload hash, see ESPLogger::sendStatus)
+#ifndef LOGGER_NVS_NAMESPACE
+#define LOGGER_NVS_NAMESPACE "esplogger"
+#endif
+
+// Wire format for the /log payload (see ESPLogger::setLogFormat)
+enum LogFormat
+{
+  LOG_FORMAT_JSON,
+  LOG_FORMAT_MSGPACK
+};
+
+// Stages of the batch pipeline inside ESPLogger::tick(); the machine
+// resumes where it left off on the next tick when the budget runs out
+enum TickState
+{
+  LOGGER_IDLE,
+  LOGGER_SERIALIZE,
+  LOGGER_TRANSMIT,
+  LOGGER_DRAIN
+};
+
+// State preserved across deep sleep: time base, wake-cycle counter and
+// pending readings. Lives in RTC slow memory, so it survives
+// esp_deep_sleep_start() but not power loss.
+struct LoggerRtcState
+{
+  u32_t magic;
+  u32_t unixTime; // "unix" collides with a GCC builtin macro in gnu++ modes
+  u64_t sleepUs;
+  u16_t wakeCount;
+  u16_t recordCount;
+  SpoolRecord records[LOGGER_RTC_READINGS];
+};
+// Single RTC-resident instance however many translation units include
+// this header: a function-local static inside an inline function
+// collapses to one definition, where a namespace-scope static would
+// give each TU its own diverging copy
+inline LoggerRtcState &loggerRtcState()
+{
+  static RTC_DATA_ATTR LoggerRtcState state;
+  return state;
+}
+
+// Print adapter that appends into a String; backs the legacy
+// String-returning diagnostic API with the streaming implementation
+class StringPrinter : public Print
+{
+public:
+  StringPrinter(String &target) : _target(target) {}
+  size_t write(uint8_t c) override
+  {
+    _target += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    _target.concat((const char *)buffer, size);
+    return size;
+  }
+
+private:
+  String &_target;
+};
+
+class Sensor : public Printable
 {
 public:
   Sensor(const String &name = "", const String &unit = "", const String &type = "", float (*callback)() = nullptr)
@@ -46,15 +180,23 @@ public:
     _unit = unit;
     _type = type;
     _callback = callback;
-    _sensor[F("name")] = _name;
-    _sensor[F("unit")] = _unit;
-    _sensor[F("sensor_type")] = _type;
+  }
+  // Flash-resident metadata path: the strings are referenced, not
+  // copied, so pass literals (or other storage that outlives the
+  // sensor). Saves three heap Strings per sensor; on the ESP32 literal
+  // data stays in flash.
+  Sensor(const char *name, const char *unit, const char *type, float (*callback)())
+  {
+    _nameP = name;
+    _unitP = unit;
+    _typeP = type;
+    _callback = callback;
   }
 
   float getValue()
   {
 
-    DL_printf("Getting value for sensor: %s\n", _name.c_str());
+    DL_printf("Getting value for sensor: %s\n", name());
     if (_callback)
     {
       _value = _callback();
@@ -63,26 +205,151 @@ public:
     }
     return 0;
   }
+  // Streams the diagnostic line straight to any Print target (Serial,
+  // display driver, WebServer response) with zero heap allocation
+  size_t printDiagnosticTo(Print &out)
+  {
+    size_t n = 0;
+    n += out.print(name());
+    n += out.print(F(":  "));
+    n += out.print(getValue());
+    n += out.print(F(" "));
+    n += out.print(unit());
+    return n;
+  }
+  // Printable, so a Sensor can be handed to Serial.println() directly.
+  // printTo must be const; reading the sensor is not, hence the cast.
+  size_t printTo(Print &out) const override
+  {
+    return const_cast<Sensor *>(this)->printDiagnosticTo(out);
+  }
   String diagnostic()
   {
     String output;
-    output += _name + F(":  ");
-    output += String(getValue());
-    output += F(" ");
-    output += _unit;
+    StringPrinter printer(output);
+    printDiagnosticTo(printer);
     return output;
   }
+  const char *name()
+  {
+    return _nameP ? _nameP : _name.c_str();
+  }
+  const char *unit()
+  {
+    return _unitP ? _unitP : _unit.c_str();
+  }
+  const char *type()
+  {
+    return _typeP ? _typeP : _type.c_str();
+  }
   String getName()
   {
-    return _name;
+    return String(name());
   }
   String getUnit()
   {
-    return _unit;
+    return String(unit());
   }
   String getType()
   {
-    return _type;
+    return String(type());
+  }
+  // Interval in seconds between reads for this sensor; 0 (the default)
+  // inherits the logger-wide sensorReadInterval. Slow sensors can then
+  // sample at their natural rate without forcing the fast ones down.
+  // To change the interval of an already-registered sensor use
+  // ESPLogger::setSensorReadInterval(index, seconds): the logger caches
+  // the earliest due time, which this setter cannot invalidate, so a
+  // shortened interval would not take effect until that time passes.
+  void setReadInterval(u32_t seconds)
+  {
+    _readInterval = seconds;
+    _nextRead = 0;
+  }
+  u32_t getReadInterval()
+  {
+    return _readInterval;
+  }
+  // Only buffer a reading when it moved more than epsilon away from the
+  // last one actually stored; a heartbeat after maxGapSeconds keeps the
+  // series alive through flat stretches. epsilon 0 (default) stores
+  // every reading.
+  void setDeadband(float epsilon, u32_t maxGapSeconds = 300)
+  {
+    _deadband = epsilon;
+    _maxGap = maxGapSeconds;
+  }
+  // Collapse all samples of a log interval into one {min, max, mean,
+  // count} record, maintained incrementally in O(1) per sample. The
+  // buffer then holds accumulators instead of hundreds of raw readings;
+  // the record's value field carries the mean so existing dashboards
+  // keep charting.
+  void setAggregation(bool aggregate)
+  {
+    _aggregate = aggregate;
+    _aggCount = 0;
+  }
+  // Snap readings to a fixed step (the sensor's real resolution) and
+  // serialize them with that many decimals. A 12-bit ADC gains nothing
+  // from "23.450000123": quantizing on entry strips the noise digits
+  // before dead-band and aggregation compare values - adjacent noise
+  // readings collapse onto the same step and the dead-band can drop
+  // them - and the serializer then emits "23.45", or an integer step
+  // count in the compact binary format (the step is registered with
+  // the sensor metadata so the server can scale back). step 0 disables.
+  void setQuantization(float step, u8_t decimals = 2)
+  {
+    _quantStep = step;
+    _quantDecimals = decimals;
+  }
+  // Budget in microseconds for one callback read; 0 (the default) turns
+  // supervision off. After strikes consecutive over-budget reads the
+  // sensor is quarantined: its callback is skipped for holdoffSeconds,
+  // then a single probe read decides whether it rejoins the schedule.
+  // Supervision is cooperative - a blocking callback cannot be
+  // preempted, the overrun is caught after it returns - but it stops a
+  // degraded sensor from stalling every tick from then on.
+  void setReadTimeout(u32_t budgetMicros, u8_t strikes = 3, u32_t holdoffSeconds = 60)
+  {
+    _readBudgetMicros = budgetMicros;
+    _readStrikeLimit = strikes;
+    _readHoldoff = holdoffSeconds;
+    _readStrikes = 0;
+    _quarantined = false;
+  }
+  // Duration of the most recent supervised read
+  u32_t lastReadDurationMicros()
+  {
+    return _lastReadMicros;
+  }
+  bool isQuarantined()
+  {
+    return _quarantined;
+  }
+  // Fire an immediate alert when the predicate returns true for a
+  // fresh reading: the logger posts that single reading right away
+  // instead of waiting for the batch schedule (see ESPLogger tick).
+  // cooldownSeconds bounds how often one sensor can alert; the reading
+  // also stays in the ring, so the regular batch keeps the series
+  // complete. Scalar reads only - bulk callbacks own their filtering.
+  void setTrigger(bool (*predicate)(float value), u32_t cooldownSeconds = 60)
+  {
+    _trigger = predicate;
+    _triggerCooldown = cooldownSeconds;
+  }
+  // Writes up to maxValues samples into out and returns how many it
+  // filled; the whole burst is stamped with the read timestamp
+  typedef u16_t (*BulkCallback)(float *out, u16_t maxValues);
+  // Burst sources (I2S microphones, FIFO-backed IMUs, DMA ADC reads)
+  // deliver many samples per read. The bulk callback writes them into
+  // the value array in place - one contiguous span, then the wrap-around
+  // span if the first was filled - so no sample is copied twice.
+  // Readings arrive pre-formed: dead-band and aggregation do not apply,
+  // the callback owns any filtering. Replaces the scalar callback when
+  // set.
+  void setBulkCallback(BulkCallback callback)
+  {
+    _bulkCallback = callback;
   }
 
 protected:
@@ -90,33 +357,339 @@ protected:
   friend class ESPLogger;
   void run(u32_t timestamp = 0)
   {
+    if (_quarantined and timestamp < _quarantineUntil)
+    {
+      return;
+    }
+    if (_bulkCallback)
+    {
+      _runBulk(timestamp);
+      return;
+    }
+    u32_t started = micros();
     _value = getValue();
-    JsonDocument sensorValue;
-    sensorValue[F("value")] = _value;
-    sensorValue[F("timestamp")] = timestamp;
-    _sensorValues.add(sensorValue);
-    // String output;
-    // serializeJson(_sensorValues, output);
-    // DL_printf("Sensor values: %s\n", output.c_str());
+    _lastReadMicros = micros() - started;
+    _value = _quantize(_value);
+    if (_readBudgetMicros)
+    {
+      if (_lastReadMicros > _readBudgetMicros)
+      {
+        if (_quarantined or ++_readStrikes >= _readStrikeLimit)
+        {
+          // Third strike (or a failed probe read): bench the sensor so
+          // it cannot stall the sampling loop every interval
+          DL_printf("Sensor %s over budget (%u us), quarantined\n", name(), _lastReadMicros);
+          _quarantined = true;
+          _quarantineUntil = timestamp + _readHoldoff;
+          return;
+        }
+      }
+      else
+      {
+        _readStrikes = 0;
+        _quarantined = false;
+      }
+    }
+    if (_trigger and _trigger(_value) and timestamp - _lastTriggerAt >= _triggerCooldown)
+    {
+      _alertPending = true;
+      _alertValue = _value;
+      _alertTimestamp = timestamp;
+      _lastTriggerAt = timestamp;
+    }
+    if (_aggregate)
+    {
+      if (!_aggCount)
+      {
+        _aggMin = _value;
+        _aggMax = _value;
+        _aggSum = 0;
+      }
+      else
+      {
+        if (_value < _aggMin)
+          _aggMin = _value;
+        if (_value > _aggMax)
+          _aggMax = _value;
+      }
+      _aggSum += _value;
+      _aggCount++;
+      _aggTimestamp = timestamp;
+      return;
+    }
+    // Dead-band suppression: unchanged values stay out of the buffer
+    // (and off the wire) until the heartbeat gap expires
+    if (_deadband > 0 && _lastStoredValid &&
+        fabsf(_value - _lastStored) <= _deadband &&
+        timestamp - _lastStoredTimestamp < _maxGap)
+    {
+      return;
+    }
+    _store(_value, timestamp);
+  }
+  // Bulk read: hand the callback the writable tail of the value array
+  // as at most two contiguous spans. The whole burst shares the read
+  // timestamp (one delta for every sample), which matches what a FIFO
+  // drain delivers; drop-oldest semantics match _store - the whole ring
+  // is writable, overrunning it just overwrites the oldest samples.
+  void _runBulk(u32_t timestamp)
+  {
+    u32_t started = micros();
+    u16_t span = LOGGER_SENSOR_BUFFER_SIZE - _head;
+    u16_t total = _bulkCallback(&_values[_head], span);
+    if (total > span)
+    {
+      total = span;
+    }
+    if (total == span and _head)
+    {
+      u16_t n = _bulkCallback(&_values[0], _head);
+      total += n > _head ? _head : n;
+    }
+    _lastReadMicros = micros() - started;
+    if (!total)
+    {
+      return;
+    }
+    if (!_count)
+    {
+      _baseTimestamp = timestamp;
+    }
+    u16_t dt = _deltaFor(timestamp);
+    for (u16_t i = 0; i < total; i++)
+    {
+      u16_t slot = (_head + i) % LOGGER_SENSOR_BUFFER_SIZE;
+      _dts[slot] = dt;
+      _values[slot] = _quantize(_values[slot]);
+    }
+    float last = _values[(_head + total - 1) % LOGGER_SENSOR_BUFFER_SIZE];
+    _head = (_head + total) % LOGGER_SENSOR_BUFFER_SIZE;
+    _count = min((u16_t)(_count + total), (u16_t)LOGGER_SENSOR_BUFFER_SIZE);
+    _value = last;
+    _lastStored = last;
+    _lastStoredTimestamp = timestamp;
+    _lastStoredValid = true;
+  }
+  // Drop-oldest ring write: no allocation, fixed footprint. Also used
+  // to re-insert readings preserved across deep sleep.
+  void _store(float value, u32_t timestamp)
+  {
+    if (!_count)
+    {
+      _baseTimestamp = timestamp;
+    }
+    _values[_head] = value;
+    _dts[_head] = _deltaFor(timestamp);
+    _head = (_head + 1) % LOGGER_SENSOR_BUFFER_SIZE;
+    if (_count < LOGGER_SENSOR_BUFFER_SIZE)
+    {
+      _count++;
+    }
+    _lastStored = value;
+    _lastStoredTimestamp = timestamp;
+    _lastStoredValid = true;
+  }
+  // Offset of timestamp from the buffer's base. When the u16 range
+  // (~18 h) would overflow, stored deltas are rebased onto the oldest
+  // reading first; a gap still wider than that clamps rather than
+  // corrupts the series.
+  u16_t _deltaFor(u32_t timestamp)
+  {
+    if (timestamp <= _baseTimestamp)
+    {
+      return 0;
+    }
+    u32_t offset = timestamp - _baseTimestamp;
+    if (offset > 0xFFFF and _count)
+    {
+      _rebase();
+      offset = timestamp > _baseTimestamp ? timestamp - _baseTimestamp : 0;
+    }
+    if (offset > 0xFFFF)
+    {
+      offset = 0xFFFF;
+    }
+    return (u16_t)offset;
+  }
+  // Shift the base up to the oldest buffered reading so new deltas fit
+  void _rebase()
+  {
+    u16_t index = (_head + LOGGER_SENSOR_BUFFER_SIZE - _count) % LOGGER_SENSOR_BUFFER_SIZE;
+    u16_t oldest = _dts[index];
+    for (u16_t i = 0; i < _count; i++)
+    {
+      _dts[(index + i) % LOGGER_SENSOR_BUFFER_SIZE] -= oldest;
+    }
+    _baseTimestamp += oldest;
+  }
+  u32_t _timestampAt(u16_t index)
+  {
+    return _baseTimestamp + _dts[index];
+  }
+  float _quantize(float value)
+  {
+    return _quantStep > 0 ? roundf(value / _quantStep) * _quantStep : value;
   }
   JsonDocument getJson()
   {
-    JsonDocument doc = _sensor;
-    doc[F("sensor_values")] = _sensorValues;
-    // Display the JSON document
-    _sensorValues.clear();
+    // Metadata is serialized on demand instead of being kept as a
+    // duplicate JsonDocument for the sensor's whole lifetime
+    JsonDocument doc;
+    doc[F("name")] = name();
+    doc[F("unit")] = unit();
+    doc[F("sensor_type")] = type();
+    JsonArray values = doc[F("sensor_values")].to<JsonArray>();
+    if (_aggregate)
+    {
+      // One aggregate record per log interval
+      if (_aggCount)
+      {
+        JsonObject reading = values.add<JsonObject>();
+        reading[F("value")] = _aggSum / _aggCount;
+        reading[F("min")] = _aggMin;
+        reading[F("max")] = _aggMax;
+        reading[F("count")] = _aggCount;
+        reading[F("timestamp")] = _aggTimestamp;
+      }
+      return doc;
+    }
+    // JSON is only built here, once per log, from the POD buffers.
+    // Timestamps travel as one shared base plus small per-reading
+    // deltas, so the timestamp column costs a few digits per reading
+    // instead of ten.
+    doc[F("base_timestamp")] = _baseTimestamp;
+    u16_t index = (_head + LOGGER_SENSOR_BUFFER_SIZE - _count) % LOGGER_SENSOR_BUFFER_SIZE;
+    for (u16_t i = 0; i < _count; i++)
+    {
+      JsonObject reading = values.add<JsonObject>();
+      if (_quantStep > 0)
+      {
+        // Fixed-decimal text: the step already bounds the precision
+        reading[F("value")] = serialized(String(_values[index], _quantDecimals));
+      }
+      else
+      {
+        reading[F("value")] = _values[index];
+      }
+      reading[F("dt")] = _dts[index];
+      index = (index + 1) % LOGGER_SENSOR_BUFFER_SIZE;
+    }
     return doc;
   }
+  // Buffered readings survive getJson() so a failed send can still
+  // spool them; the logger clears them once the batch outcome is known
+  void clearReadings()
+  {
+    _count = 0;
+    _head = 0;
+    _aggCount = 0;
+  }
+  // Copy buffered readings into fixed-width spool records and clear
+  u16_t drainTo(SpoolRecord *out, u16_t maxRecords, u8_t sensorIndex)
+  {
+    if (_aggregate)
+    {
+      // The aggregate collapses to a single mean record (min/max are
+      // not representable in the fixed spool format)
+      if (!_aggCount || !maxRecords)
+      {
+        return 0;
+      }
+      out[0].sensorIndex = sensorIndex;
+      out[0].timestamp = _aggTimestamp;
+      out[0].value = _aggSum / _aggCount;
+      _aggCount = 0;
+      return 1;
+    }
+    u16_t drained = 0;
+    u16_t index = (_head + LOGGER_SENSOR_BUFFER_SIZE - _count) % LOGGER_SENSOR_BUFFER_SIZE;
+    while (_count && drained < maxRecords)
+    {
+      out[drained].sensorIndex = sensorIndex;
+      out[drained].timestamp = _timestampAt(index);
+      out[drained].value = _values[index];
+      index = (index + 1) % LOGGER_SENSOR_BUFFER_SIZE;
+      _count--;
+      drained++;
+    }
+    if (!_count)
+    {
+      _head = 0;
+    }
+    return drained;
+  }
 
 private:
   float (*_callback)();
-  JsonDocument _sensor;
-  JsonDocument _sensorValues;
+  // SoA layout: values and u16 timestamp deltas (from _baseTimestamp)
+  // live in separate arrays - 6 bytes per reading instead of 8, and the
+  // serializer walks a dense float array
+  float _values[LOGGER_SENSOR_BUFFER_SIZE];
+  u16_t _dts[LOGGER_SENSOR_BUFFER_SIZE];
+  u32_t _baseTimestamp = 0;
+  u16_t _head = 0;
+  u16_t _count = 0;
+  u32_t _readInterval = 0;
+  u32_t _nextRead = 0;
+  float _deadband = 0;
+  u32_t _maxGap = 300;
+  float _quantStep = 0;
+  u8_t _quantDecimals = 2;
+  bool _aggregate = false;
+  float _aggMin = 0;
+  float _aggMax = 0;
+  float _aggSum = 0;
+  u16_t _aggCount = 0;
+  u32_t _aggTimestamp = 0;
+  float _lastStored = 0;
+  u32_t _lastStoredTimestamp = 0;
+  bool _lastStoredValid = false;
+  const char *_nameP = nullptr;
+  const char *_unitP = nullptr;
+  const char *_typeP = nullptr;
   String _name;
   String _unit;
   String _type;
   float _value;
+  BulkCallback _bulkCallback = nullptr;
+  bool (*_trigger)(float) = nullptr;
+  u32_t _triggerCooldown = 60;
+  u32_t _lastTriggerAt = 0;
+  bool _alertPending = false;
+  float _alertValue = 0;
+  u32_t _alertTimestamp = 0;
+  u32_t _readBudgetMicros = 0;
+  u8_t _readStrikeLimit = 3;
+  u32_t _readHoldoff = 60;
+  u32_t _lastReadMicros = 0;
+  u8_t _readStrikes = 0;
+  bool _quarantined = false;
+  u32_t _quarantineUntil = 0;
+};
+// Pipeline counters for field tuning. "last" fields cover the most
+// recent occurrence, "total" fields accumulate until resetMetrics();
+// timings are microseconds. Heap fields are sampled when getMetrics is
+// called.
+struct LoggerMetrics
+{
+  u32_t lastSampleMicros = 0;
+  u64_t totalSampleMicros = 0;
+  u32_t lastSerializeMicros = 0;
+  u64_t totalSerializeMicros = 0;
+  u32_t lastPostMicros = 0;
+  u64_t totalPostMicros = 0;
+  u32_t lastParseMicros = 0;
+  u64_t totalParseMicros = 0;
+  u32_t lastHandshakeMicros = 0;
+  u64_t totalHandshakeMicros = 0;
+  size_t lastPayloadBytes = 0;
+  u32_t batchesSent = 0;
+  u32_t retries = 0;
+  u32_t batchesDropped = 0;
+  u32_t freeHeap = 0;
+  u32_t maxAllocBlock = 0;
 };
+
 template <int NumSensors>
 class ESPLogger
 {
@@ -157,14 +730,49 @@ public:
     _apiKey = "Bearer " + api_key;
     setLogInterval(logInterval);
     setSensorReadInterval(sensorReadInterval);
+    reservePayload(LOGGER_PAYLOAD_RESERVE);
+    _startSntp();
     start();
+    return sendStatus();
+  }
+  // POST the device + sensor-metadata document, or skip the round-trip
+  // when it matches the hash persisted from the last successful send -
+  // on a deep-sleep fleet the registration POST usually costs more
+  // airtime than the batch itself, and it rarely changes between wakes.
+  // The skip also requires time sync without the server (SNTP), since
+  // the status response normally carries unix_time. Pass force = true
+  // after genuine reconfiguration.
+  bool sendStatus(bool force = false)
+  {
     String payload;
-    serializeJson(_device, payload);
-    return _sendStatus(payload);
+    _buildStatusPayload(payload);
+    u32_t hash = _fnv1a(payload);
+    // With metrics embedded the payload changes every boot and the
+    // server is meant to see it - never skip then
+    if (!force and !_metricsInStatus and hash == _loadStatusHash() and _syncTime())
+    {
+      DL_println("Status unchanged since last boot; skipping POST");
+      return true;
+    }
+    if (_sendStatus(payload))
+    {
+      _storeStatusHash(hash);
+      return true;
+    }
+    return false;
   }
-  // Call tick in your loop to log sensor values
-  bool tick()
+  // Call tick in your loop to log sensor values.
+  // - budgetMs: optional hard bound on time spent in this call. The
+  //   batch pipeline (serialize -> transmit -> drain) is an explicit
+  //   state machine that resumes where it left off on the next tick,
+  //   and retries are scheduled across ticks instead of delay()ed
+  //   in-call, so loop latency stays bounded regardless of network
+  //   state. 0 (the default) runs the due stages to completion.
+  // Returns true once the current batch has been delivered (or, in
+  // async mode, enqueued).
+  bool tick(u32_t budgetMs = 0)
   {
+    u32_t budgetStart = millis();
     if (!_transmitting)
     {
       return false;
@@ -174,43 +782,279 @@ public:
       _syncTime();
       return false;
     }
-    _updateSensors();
-    if (getUnix() - _lastLog > _logInterval)
+    // Sampling runs every call, whatever the pipeline is doing, so slow
+    // transmissions cannot leave holes in the series
+    if (_updateSensors())
+    {
+      // Alerts can only fire on a tick that actually read sensors
+      _dispatchAlerts();
+    }
+    bool delivered = false;
+    while (true)
     {
-      _lastLog = getUnix();
-      DL_println("Logging data");
-      for (int i = 0; i < NumSensors; i++)
+      switch (_state)
+      {
+      case LOGGER_IDLE:
+        if (getUnix() - _lastLog <= _effectiveLogInterval())
+        {
+          _drainSpool();
+          return false;
+        }
+        _state = LOGGER_SERIALIZE;
+        break;
+      case LOGGER_SERIALIZE:
+        DL_println("Logging data");
+#ifndef LOGGER_NATIVE
+        if (_async)
+        {
+          // Hand the batch to the transmission task; for JSON batches
+          // even serialization happens over there (see _enqueueBatch),
+          // so this core pays only for the record drain and sampling
+          // resumes immediately
+          _lastLog = getUnix();
+          if (_enqueueBatch())
+          {
+            loggerRtcState().wakeCount = 0;
+            delivered = true;
+          }
+          _state = LOGGER_DRAIN;
+          break;
+        }
+#endif
+        if (_logFormat == LOG_FORMAT_JSON)
+        {
+          for (u8_t d = 0; d < _sensorCount; d++)
+          {
+            _deviceSensors.add(_sensors[_occupied[d]]->getJson());
+          }
+        }
+        if (_streamPayload && _logFormat == LOG_FORMAT_JSON)
+        {
+          // Streamed mode serializes into the socket, so there is no
+          // stored payload to resume from; it transmits inline
+          _lastLog = getUnix();
+          if (_sendDataStreamed())
+          {
+            _clearSensorReadings();
+            loggerRtcState().wakeCount = 0;
+            delivered = true;
+          }
+          else if (_spoolEnabled)
+          {
+            _spoolReadings();
+          }
+          else
+          {
+            _metrics.batchesDropped++;
+            _clearSensorReadings();
+          }
+          _noteBatchOutcome(delivered);
+          _state = LOGGER_DRAIN;
+          break;
+        }
+        _payload.clear();
+        _serializeBatch(_payload);
+#ifdef LOGGER_ENABLE_DEFLATE
+        if (_compress && _payload.length() >= LOGGER_COMPRESS_MIN_BYTES)
+        {
+          // Compress once; every transmit attempt reuses the buffer
+          mz_ulong bound = mz_compressBound(_payload.length());
+          u8_t *buffer = (u8_t *)malloc(bound);
+          if (buffer)
+          {
+            mz_ulong compressedLength = bound;
+            if (mz_compress2(buffer, &compressedLength, (const unsigned char *)_payload.c_str(), _payload.length(), MZ_BEST_SPEED) == MZ_OK && compressedLength < _payload.length())
+            {
+              DL_printf("Compressed payload %u -> %u bytes\n", _payload.length(), (unsigned)compressedLength);
+              _compressed = buffer;
+              _compressedLength = compressedLength;
+            }
+            else
+            {
+              free(buffer);
+            }
+          }
+        }
+#endif
+        // Snapshot the serialized readings out of the ring buffers now:
+        // retries stretch across ticks and sampling keeps running, so
+        // settling the batch later must not wipe (or double-spool) the
+        // readings taken while it was in flight
+        _takePendingRecords();
+        for (int i = 0; i <= _mirrorCount; i++)
+        {
+          _epPending[i] = true;
+          _epRetries[i] = 0;
+        }
+        _nextAttemptMs = 0;
+        _batchStartMs = millis();
+        _state = LOGGER_TRANSMIT;
+        break;
+      case LOGGER_TRANSMIT:
       {
-        if (_sensors[i])
+        if (_nextAttemptMs && millis() < _nextAttemptMs)
         {
-          _deviceSensors.add(_sensors[i]->getJson());
+          // Backoff window still open; resume on a later tick
+          return delivered;
         }
+        // One POST per pass: service the first endpoint still pending
+        // (slot 0 is the primary, the rest are mirrors)
+        int ep = 0;
+        while (ep <= _mirrorCount && !_epPending[ep])
+        {
+          ep++;
+        }
+        DL_printf("Sending data endpoint %i try: %i\n", ep, _epRetries[ep]);
+        const u8_t *body = _compressed ? _compressed : (const u8_t *)_payload.c_str();
+        size_t length = _compressed ? _compressedLength : _payload.length();
+        bool sent = ep == 0 ? _sendAttempt(body, length, _compressed != nullptr)
+                            : _sendMirrorAttempt(ep - 1, body, length, _compressed != nullptr);
+        if (sent)
+        {
+          _epPending[ep] = false;
+          if (ep == 0)
+          {
+            _lastLog = getUnix();
+            _dropPendingRecords();
+            loggerRtcState().wakeCount = 0;
+            delivered = true;
+            _noteBatchOutcome(true);
+          }
+        }
+        else if (++_epRetries[ep] > LOGGER_TX_RETRIES or millis() - _batchStartMs >= LOGGER_INFLIGHT_MAX_MS)
+        {
+          _epPending[ep] = false;
+          if (ep == 0)
+          {
+            // Batch could not be delivered: keep its snapshot on flash
+            // if spooling is enabled, otherwise drop it as before
+            _lastLog = getUnix();
+            _noteBatchOutcome(false);
+            if (_pendingRecords and _spoolEnabled)
+            {
+              if (!_spool.append(_pendingRecords, _pendingRecordCount))
+              {
+                DL_println("Spool append failed, dropping readings");
+                _metrics.batchesDropped++;
+              }
+            }
+            else if (_pendingRecords)
+            {
+              _metrics.batchesDropped++;
+            }
+            _dropPendingRecords();
+          }
+        }
+        else
+        {
+          _metrics.retries++;
+          // Exponential backoff with jitter: immediate identical
+          // retries mostly hit the same transient failure, and jitter
+          // keeps a fleet from retrying in sync after a shared outage
+          u32_t backoff = LOGGER_RETRY_BASE_MS << (_epRetries[ep] - 1);
+          backoff += esp_random() % (backoff / 2 + 1);
+          _nextAttemptMs = millis() + backoff;
+          return delivered;
+        }
+        bool anyPending = false;
+        for (int i = 0; i <= _mirrorCount; i++)
+        {
+          anyPending |= _epPending[i];
+        }
+        if (!anyPending)
+        {
+          _finishTransmit();
+          _state = LOGGER_DRAIN;
+        }
+        break;
       }
-      String payload;
-      serializeJson(_device, payload);
-      if (_sendData(payload))
+      case LOGGER_DRAIN:
+        _drainSpool();
+        _state = LOGGER_IDLE;
+        return delivered;
+      }
+      if (budgetMs && millis() - budgetStart >= budgetMs)
       {
-        _lastLog = getUnix();
-        return true;
+        return delivered;
       }
     }
-    return false;
   }
-  String sensorsDiagnostic()
+  // Keep readings from failed sends in a binary append-log on LittleFS
+  // and replay them opportunistically once the server is reachable again
+  // - maxBytes: cap on the spool file size (default 64 KB)
+  bool enableSpool(size_t maxBytes = 65536)
   {
-    String output = F("");
-    for (int i = 0; i < NumSensors; i++)
+    _spoolEnabled = _spool.begin(maxBytes);
+    return _spoolEnabled;
+  }
+  size_t spoolPending()
+  {
+    return _spoolEnabled ? _spool.pending() : 0;
+  }
+#ifndef LOGGER_NATIVE
+  // Move transmission onto a dedicated FreeRTOS task so tick() only
+  // enqueues finished batches and never blocks on HTTP/TLS. Call once
+  // after init(); delivery outcome is reported via setOnDelivery.
+  // - core: core to pin the task to (default 0, alongside the WiFi stack)
+  bool beginAsync(BaseType_t core = 0, u32_t stackSize = 8192)
+  {
+    if (_txTask)
+    {
+      return true;
+    }
+    _txQueue = xQueueCreate(LOGGER_TX_QUEUE_LENGTH, sizeof(TxBatch));
+    _httpMutex = xSemaphoreCreateMutex();
+    if (!_txQueue or !_httpMutex or
+        xTaskCreatePinnedToCore(_txTaskLoop, "esplogger_tx", stackSize, this, 1, &_txTask, core) != pdPASS)
     {
-      if (_sensors[i])
+      // Tear down whatever was created: a leftover mutex would make
+      // every HTTP call pay for an async mode that never started
+      if (_txQueue)
+      {
+        vQueueDelete(_txQueue);
+        _txQueue = nullptr;
+      }
+      if (_httpMutex)
       {
-        output += _sensors[i]->diagnostic() + F("\n");
+        vSemaphoreDelete(_httpMutex);
+        _httpMutex = nullptr;
       }
+      return false;
+    }
+    _async = true;
+    return true;
+  }
+#endif
+  // Called from the transmission task with the delivery outcome of each
+  // enqueued batch
+  void setOnDelivery(void (*callback)(bool success))
+  {
+    _onDelivery = callback;
+  }
+  // Streams every sensor's diagnostic line to a Print target without
+  // touching the heap; safe to drive a status display from every second
+  size_t printDiagnosticTo(Print &out)
+  {
+    size_t n = 0;
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      n += _sensors[_occupied[d]]->printDiagnosticTo(out);
+      n += out.print('\n');
     }
+    return n;
+  }
+  String sensorsDiagnostic()
+  {
+    String output;
+    StringPrinter printer(output);
+    printDiagnosticTo(printer);
     return output;
   }
+  // Convenience overload; the sensor lives in the logger-owned slab
+  // (see addManagedSensor), so no caller-side Sensor object is needed
   bool addSensor(const String &name, const String &unit, const String &type, float (*callback)())
   {
-    return addSensor(Sensor(name, unit, type, callback));
+    return addManagedSensor(name, unit, type, callback) >= 0;
   }
   bool addSensor(Sensor &sensor)
   {
@@ -219,14 +1063,74 @@ public:
       if (!_sensors[i])
       {
         _sensors[i] = &sensor;
+        _occupied[_sensorCount] = i;
+        _slotPos[i] = _sensorCount;
+        _sensorCount++;
         return true;
       }
     }
     return false;
   }
+  // Register a sensor the logger owns: it is copied into a lazily
+  // allocated slab (one heap block holding all NumSensors cells, so
+  // runtime registration never fragments the heap) and its cell is
+  // recycled through a free list on removal. Returns the slot index
+  // batches will carry for it, or -1 when the pool is full.
+  int addManagedSensor(const char *name, const char *unit, const char *type, float (*callback)())
+  {
+    return _addManaged(Sensor(name, unit, type, callback));
+  }
+  int addManagedSensor(const String &name, const String &unit, const String &type, float (*callback)())
+  {
+    return _addManaged(Sensor(name, unit, type, callback));
+  }
+  // Unregister the sensor in a slot in O(1). Managed sensors hand their
+  // slab cell back to the free list; caller-owned sensors are detached
+  // untouched. Slot indices of the remaining sensors do not shift, so
+  // already-registered metadata stays valid server-side.
+  bool removeSensor(int index)
+  {
+    if (index < 0 or index >= NumSensors or !_sensors[index])
+    {
+      return false;
+    }
+    Sensor *sensor = _sensors[index];
+    _sensors[index] = nullptr;
+    // Swap-remove from the dense iteration list
+    u8_t pos = _slotPos[index];
+    _sensorCount--;
+    u8_t lastSlot = _occupied[_sensorCount];
+    _occupied[pos] = lastSlot;
+    _slotPos[lastSlot] = pos;
+    if (_slab and sensor >= _slab and sensor < _slab + NumSensors)
+    {
+      _freeCells[_freeCellCount++] = (u8_t)(sensor - _slab);
+      *sensor = Sensor(); // release the cell's Strings
+    }
+    return true;
+  }
+  u8_t getSensorCount()
+  {
+    return _sensorCount;
+  }
   void setSensorReadInterval(u32_t sensorReadInterval)
   {
     _sensorReadInterval = max(min((int)sensorReadInterval, MAX_SENSOR_INTERVAL), MIN_SENSOR_INTERVAL);
+    _nextSensorDue = 0;
+  }
+  // Per-sensor cadence by slot index (what addManagedSensor returned);
+  // 0 inherits the logger-wide interval. Goes through the logger so the
+  // cached earliest-due time is invalidated and a shortened interval
+  // takes effect on the next tick, not after the old due time passes.
+  bool setSensorReadInterval(int index, u32_t seconds)
+  {
+    if (index < 0 or index >= NumSensors or !_sensors[index])
+    {
+      return false;
+    }
+    _sensors[index]->setReadInterval(seconds);
+    _nextSensorDue = 0;
+    return true;
   }
   u32_t getSensorReadInterval()
   {
@@ -240,6 +1144,67 @@ public:
   {
     return _logInterval;
   }
+  // Interval currently in force, including any backpressure stretch
+  u32_t getEffectiveLogInterval()
+  {
+    return _effectiveLogInterval();
+  }
+  // Preallocates the payload buffer so serialization never reallocates
+  // mid-batch; sized from the high-water mark after the first batches.
+  // Call before init with a measured value to skip the warm-up growth.
+  bool reservePayload(size_t bytes)
+  {
+    if (bytes > _payloadCapacity)
+    {
+      _payloadCapacity = bytes;
+    }
+    return _payload.reserve(_payloadCapacity);
+  }
+  size_t getPayloadCapacity()
+  {
+    return _payloadCapacity;
+  }
+  // Largest serialized batch seen so far
+  size_t getPayloadHighWater()
+  {
+    return _payloadHighWater;
+  }
+  const LoggerMetrics &getMetrics()
+  {
+    _metrics.freeHeap = ESP.getFreeHeap();
+    _metrics.maxAllocBlock = ESP.getMaxAllocHeap();
+    return _metrics;
+  }
+  void resetMetrics()
+  {
+    _metrics = LoggerMetrics();
+  }
+  // Attach the metrics block to future status payloads so the server
+  // sees device health without a separate channel
+  void setMetricsInStatus(bool enable)
+  {
+    _metricsInStatus = enable;
+  }
+  // Pin the server certificate (its own cert or the issuing CA, PEM).
+  // Validating against a single pinned cert skips the full-bundle chain
+  // walk and is the cheap/secure middle ground between setInsecure()
+  // and a CA bundle. The PEM is referenced, not copied - pass a literal
+  // or other storage that outlives the logger. nullptr reverts to
+  // insecure mode. arduino-esp32 does not expose TLS session tickets,
+  // so to amortize the handshake itself pair this with
+  // setKeepAlive(true), which holds the session open between batches;
+  // getMetrics().lastHandshakeMicros reports what each handshake cost.
+  void setServerCertificate(const char *caPem)
+  {
+    _caCert = caPem;
+    // Drop any cached connection so the next one validates the pin
+    if (_client)
+    {
+      _client->stop();
+      delete _client;
+      _client = nullptr;
+    }
+  }
   void setFirmwareVersion(const String &version)
   {
     _device[F("firmware_version")] = version;
@@ -266,6 +1231,18 @@ public:
       u32_t diff = millis() - _lastUnix;
       if (_unix && diff > 86400000ul)
       {
+        if (_sntpStarted)
+        {
+          // Re-anchor on the SNTP-disciplined clock instead of letting
+          // raw millis() bookkeeping accumulate drift
+          time_t now = time(nullptr);
+          if ((u32_t)now > LOGGER_EPOCH_VALID)
+          {
+            _unix = now;
+            _lastUnix = millis();
+            return _unix;
+          }
+        }
         _unix += diff / 1000ul;
         _lastUnix = millis() - diff % 1000ul;
       }
@@ -273,7 +1250,95 @@ public:
     }
     return 0;
   }
-  void setTransmitting(bool transmitting)
+  // Background SNTP (single UDP datagram via the ESP32's built-in
+  // client) is the default time source; the HTTPS /time endpoint is
+  // only used as a fallback when UDP is blocked. Pass nullptr to force
+  // HTTP-only sync.
+  void setSntpServer(const char *server)
+  {
+    _sntpServer = server;
+    _useSntp = server != nullptr;
+  }
+  // Mirror every log batch to an additional endpoint (e.g. a local
+  // on-prem collector next to esplogger.tech). The batch is serialized
+  // once and posted to each endpoint with independent retry state, so a
+  // mirror costs one extra socket write rather than a second copy of
+  // the whole pipeline. Spool replay stays tied to the primary.
+  // Mutually exclusive with setStreamingMode: the streamed writer
+  // serializes straight into one socket and keeps no buffer to replay,
+  // so the combination is refused rather than silently skipping
+  // mirrors.
+  // - url: server host, as passed to the constructor
+  // - apiKey: key for the mirror; empty reuses the primary key
+  bool addEndpoint(const String &url, const String &apiKey = "", bool secure = true)
+  {
+    if (_mirrorCount >= LOGGER_MAX_ENDPOINTS)
+    {
+      return false;
+    }
+    if (_streamPayload)
+    {
+      DL_println("Mirrors are unavailable in streaming mode");
+      return false;
+    }
+    String prefix = secure ? F("https://") : F("http://");
+    _mirrors[_mirrorCount].logUrl = prefix + url + API_SUFFIX + LOG_PATH;
+    _mirrors[_mirrorCount].apiKey = apiKey.length() ? "Bearer " + apiKey : "";
+    _mirrorCount++;
+    return true;
+  }
+  // Compress log POST bodies with deflate (zlib stream, Content-
+  // Encoding: deflate) once they exceed LOGGER_COMPRESS_MIN_BYTES;
+  // repetitive JSON batches typically shrink ~8x, cutting metered
+  // uplink bytes and radio airtime. Requires building with
+  // -DLOGGER_ENABLE_DEFLATE and a miniz library dependency; without
+  // the flag this is a no-op.
+  void setCompression(bool compress)
+  {
+    _compress = compress;
+  }
+  // Wire format for the /log payload. LOG_FORMAT_MSGPACK sends each
+  // batch as compact [sensor-index, timestamp-delta, value] tuples -
+  // sensor metadata travels once in the status payload at init() - which
+  // cuts uplink bytes to a fraction of the JSON encoding on metered
+  // backhaul. Default stays LOG_FORMAT_JSON.
+  void setLogFormat(LogFormat format)
+  {
+    _logFormat = format;
+  }
+  // Hold the connection (and its TLS session) open between requests so
+  // repeated posts skip the full handshake; dead sockets are detected
+  // cheaply and reconnected transparently on the next request. Worth
+  // ~60% of transmit energy at short log intervals on HTTPS.
+  void setKeepAlive(bool keepAlive)
+  {
+    _keepAlive = keepAlive;
+    _http->setReuse(keepAlive);
+    if (!keepAlive && _client)
+    {
+      _client->stop();
+      delete _client;
+      _client = nullptr;
+    }
+  }
+  // Serialize the log POST body directly into the socket instead of
+  // building the whole payload as a String first (Content-Length is
+  // precomputed with measureJson). Recommended for high sensor counts
+  // where the payload String may not fit in a contiguous heap block.
+  // Mutually exclusive with addEndpoint mirrors - there is no stored
+  // payload to fan out - so enabling it with mirrors configured is
+  // refused and returns false.
+  bool setStreamingMode(bool stream)
+  {
+    if (stream and _mirrorCount)
+    {
+      DL_println("Streaming mode is unavailable with mirror endpoints");
+      return false;
+    }
+    _streamPayload = stream;
+    return true;
+  }
+  void setTransmitting(bool transmitting)
   {
     _transmitting = transmitting;
   }
@@ -284,24 +1349,123 @@ public:
   void start()
   {
     _lastLog = getUnix();
-    _lastSensorRead = getUnix();
+    _nextSensorDue = 0;
     _transmitting = true;
   }
+  // ---- Deep sleep support ----
+  // Save the time base and buffered readings into RTC slow memory and
+  // arm the timer wakeup; call esp_deep_sleep_start() right after.
+  // Readings beyond LOGGER_RTC_READINGS spill to the flash spool when
+  // enabled, otherwise they are dropped.
+  void prepareSleep(u64_t sleepUs)
+  {
+    loggerRtcState().magic = LOGGER_RTC_MAGIC;
+    loggerRtcState().unixTime = getUnix();
+    loggerRtcState().sleepUs = sleepUs;
+    // A batch still in flight will not settle across a reset; its
+    // snapshot goes to flash rather than vanishing with the heap
+    if (_pendingRecords and _spoolEnabled)
+    {
+      _spool.append(_pendingRecords, _pendingRecordCount);
+    }
+    _dropPendingRecords();
+    u16_t count = 0;
+    for (u8_t d = 0; d < _sensorCount && count < LOGGER_RTC_READINGS; d++)
+    {
+      u8_t i = _occupied[d];
+      count += _sensors[i]->drainTo(loggerRtcState().records + count, LOGGER_RTC_READINGS - count, i);
+    }
+    loggerRtcState().recordCount = count;
+    if (_spoolEnabled)
+    {
+      _spoolReadings();
+    }
+    loggerRtcState().wakeCount++;
+#ifndef LOGGER_NATIVE
+    esp_sleep_enable_timer_wakeup(sleepUs);
+#endif
+  }
+  // Restore the state saved by prepareSleep(). Call after registering
+  // sensors; no WiFi needed. Returns false on cold boot (no valid RTC
+  // state) - run the normal init() path then. On success the time base
+  // is back without any HTTP round-trip and the preserved readings are
+  // in their sensors again.
+  bool restoreAfterSleep()
+  {
+    if (loggerRtcState().magic != LOGGER_RTC_MAGIC
+#ifndef LOGGER_NATIVE
+        || esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED
+#endif
+    )
+    {
+      loggerRtcState().magic = 0;
+      loggerRtcState().wakeCount = 0;
+      loggerRtcState().recordCount = 0;
+      return false;
+    }
+    _unix = loggerRtcState().unixTime + (u32_t)(loggerRtcState().sleepUs / 1000000ULL);
+    _lastUnix = millis();
+    for (u16_t r = 0; r < loggerRtcState().recordCount; r++)
+    {
+      u8_t index = loggerRtcState().records[r].sensorIndex;
+      if (index < NumSensors && _sensors[index])
+      {
+        _sensors[index]->_store(loggerRtcState().records[r].value, loggerRtcState().records[r].timestamp);
+      }
+    }
+    loggerRtcState().recordCount = 0;
+    start();
+    if (shouldTransmit())
+    {
+      // Make the batch due so the first tick() after WiFi is up sends it
+      _lastLog = _unix - _logInterval - 1;
+    }
+    return true;
+  }
+  // Accumulate this many wake cycles of readings before powering the
+  // radio at all; poll shouldTransmit() after restoreAfterSleep() to
+  // decide whether to bring WiFi up or go straight back to sleep.
+  void setWakeBatchCount(u16_t cycles)
+  {
+    _wakeBatchCount = cycles;
+  }
+  bool shouldTransmit()
+  {
+    return loggerRtcState().wakeCount >= _wakeBatchCount;
+  }
+  u16_t getWakeCount()
+  {
+    return loggerRtcState().wakeCount;
+  }
   void setOnUpdate(void (*callback)())
   {
-    httpUpdate.onStart(callback);
+    _onUpdateStart = callback;
   }
   void setOnUpdateFinished(void (*callback)())
   {
-    httpUpdate.onEnd(callback);
+    _onUpdateEnd = callback;
   }
 
 private:
-  Sensor *_sensors[NumSensors];
+  Sensor *_sensors[NumSensors] = {nullptr};
+  // Dense iteration over occupied slots: _occupied[0.._sensorCount)
+  // holds slot indices, _slotPos[i] the position of slot i within it.
+  // Loops walk only registered sensors instead of null-checking every
+  // slot of a mostly-empty array.
+  u8_t _occupied[NumSensors] = {0};
+  u8_t _slotPos[NumSensors] = {0};
+  u8_t _sensorCount = 0;
+  // Slab backing logger-owned sensors (addManagedSensor)
+  Sensor *_slab = nullptr;
+  u8_t _freeCells[NumSensors] = {0};
+  u8_t _freeCellCount = 0;
   JsonDocument _device;
   JsonArray _deviceSensors;
   u64_t _deviceId;
   HTTPClient *_http = nullptr;
+  // Held transport for keep-alive mode (see _ensureClient)
+  WiFiClient *_client = nullptr;
+  bool _keepAlive = false;
   String _deviceGroup;
   String _deviceName;
   String _logUrl;
@@ -310,16 +1474,90 @@ private:
   String _statusUrl;
   String _apiKey;
   String _firmwareVersion;
+  String _host;
+  String _logPath;
+  u16_t _port;
+  LoggerSpool _spool;
+  bool _spoolEnabled = false;
+  u32_t _lastDrain = 0;
+  u16_t _wakeBatchCount = 1;
+  const char *_sntpServer = "pool.ntp.org";
+  bool _useSntp = true;
+  bool _sntpStarted = false;
+  u32_t _sntpStartMs = 0;
+#ifndef LOGGER_NATIVE
+  TaskHandle_t _txTask = nullptr;
+  QueueHandle_t _txQueue = nullptr;
+  SemaphoreHandle_t _httpMutex = nullptr;
+#endif
+  void (*_onDelivery)(bool) = nullptr;
+  void (*_onUpdateStart)() = nullptr;
+  void (*_onUpdateEnd)() = nullptr;
+  bool _async = false;
   bool _secure;
+  const char *_caCert = nullptr; // pinned server cert (PEM, referenced)
+  LogFormat _logFormat = LOG_FORMAT_JSON;
+  bool _compress = false;
+  bool _streamPayload = false;
+  TickState _state = LOGGER_IDLE;
+  String _payload;
+  size_t _payloadCapacity = 0;
+  size_t _payloadHighWater = 0;
+  u32_t _nextAttemptMs = 0;
+  u32_t _batchStartMs = 0;
+  u8_t *_compressed = nullptr;
+  size_t _compressedLength = 0;
+  // Records covered by the serialized batch currently in flight (sync
+  // path); the ring buffers stay free for readings sampled meanwhile
+  SpoolRecord *_pendingRecords = nullptr;
+  u16_t _pendingRecordCount = 0;
+  struct Endpoint
+  {
+    String logUrl;
+    String apiKey;
+  };
+  Endpoint _mirrors[LOGGER_MAX_ENDPOINTS];
+  u8_t _mirrorCount = 0;
+  bool _epPending[LOGGER_MAX_ENDPOINTS + 1] = {false};
+  u8_t _epRetries[LOGGER_MAX_ENDPOINTS + 1] = {0};
   bool _transmitting = false;
   u32_t _unix = 0;
   u32_t _lastUnix = 0;
   u32_t _logInterval;
+  u8_t _intervalBackoff = 0; // consecutive failed batches (exponent)
+  u32_t _retryAfter = 0;     // seconds the server asked us to hold off
   u32_t _sensorReadInterval;
-  u16_t _sensorIntervalOffset = 0;
-  u32_t _lastSensorTimeStamp = 0;
-  u32_t _lastSensorRead = 0;
+  u32_t _nextSensorDue = 0;
   u32_t _lastLog = 0;
+  LoggerMetrics _metrics;
+  bool _metricsInStatus = false;
+  int _addManaged(const Sensor &sensor)
+  {
+    if (!_slab)
+    {
+      _slab = new Sensor[NumSensors];
+      if (!_slab)
+      {
+        return -1;
+      }
+      for (int i = NumSensors - 1; i >= 0; i--)
+      {
+        _freeCells[_freeCellCount++] = i;
+      }
+    }
+    if (!_freeCellCount)
+    {
+      return -1;
+    }
+    u8_t cell = _freeCells[--_freeCellCount];
+    _slab[cell] = sensor;
+    if (!addSensor(_slab[cell]))
+    {
+      _freeCells[_freeCellCount++] = cell;
+      return -1;
+    }
+    return _occupied[_sensorCount - 1];
+  }
   void _resetJSON()
   {
     _deviceSensors.clear();
@@ -330,74 +1568,865 @@ private:
     _device[F("firmware_version")] = _firmwareVersion;
     _deviceSensors = _device[F("sensors")].to<JsonArray>();
   }
-  void _updateSensors()
+  // Every sensor runs on its own cadence (Sensor::setReadInterval, 0 =
+  // logger default). The earliest due time is cached so most ticks
+  // return without touching the sensor array; at these sensor counts a
+  // scan on the due tick beats maintaining a heap or timer wheel.
+  // Returns true when at least one sensor was read.
+  bool _updateSensors()
+  {
+    u32_t now = getUnix();
+    if (_nextSensorDue && now < _nextSensorDue)
+    {
+      return false;
+    }
+    bool ran = false;
+    u32_t sampleStart = micros();
+    u32_t nextDue = 0xFFFFFFFFul;
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      Sensor *sensor = _sensors[_occupied[d]];
+      u32_t interval = sensor->_readInterval ? sensor->_readInterval : _sensorReadInterval;
+      if (!sensor->_nextRead)
+      {
+        // First pass after start(): read immediately, anchor the cadence
+        sensor->_nextRead = now;
+      }
+      if (now >= sensor->_nextRead)
+      {
+        DL_printf("Reading sensor %s on Timestamp: %u\n", sensor->name(), now);
+        sensor->run(now);
+        ran = true;
+        // Advance along the schedule, not from now, so the cadence does
+        // not drift; jump forward if we fell over an interval behind
+        sensor->_nextRead += interval;
+        if (sensor->_nextRead <= now)
+        {
+          sensor->_nextRead = now + interval;
+        }
+      }
+      if (sensor->_nextRead < nextDue)
+      {
+        nextDue = sensor->_nextRead;
+      }
+    }
+    _metrics.lastSampleMicros = micros() - sampleStart;
+    _metrics.totalSampleMicros += _metrics.lastSampleMicros;
+    _nextSensorDue = nextDue;
+    return ran;
+  }
+  // Alert lane: a fired trigger posts one minimal reading right away,
+  // ahead of the batch schedule. Best effort - a failed post is not
+  // retried, since the reading still travels with the next batch.
+  void _dispatchAlerts()
+  {
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      u8_t i = _occupied[d];
+      Sensor *sensor = _sensors[i];
+      if (!sensor->_alertPending)
+      {
+        continue;
+      }
+      sensor->_alertPending = false;
+      DL_printf("Alert from sensor %s: %f\n", sensor->name(), sensor->_alertValue);
+      JsonDocument doc;
+      doc[F("device_id")] = _deviceId;
+      doc[F("alert")] = true;
+      doc[F("sensor_index")] = i;
+      doc[F("name")] = sensor->name();
+      doc[F("value")] = sensor->_alertValue;
+      doc[F("timestamp")] = sensor->_alertTimestamp;
+      String payload;
+      serializeJson(doc, payload);
+#ifndef LOGGER_NATIVE
+      if (_async)
+      {
+        TxBatch batch;
+        batch.payload = new String(payload);
+        batch.records = nullptr;
+        batch.recordCount = 0;
+        // Jump the queue: the alert goes out before waiting batches
+        if (xQueueSendToFront(_txQueue, &batch, 0) != pdTRUE)
+        {
+          delete batch.payload;
+        }
+        continue;
+      }
+#endif
+      _postPayload(payload);
+    }
+  }
+#ifndef LOGGER_NATIVE
+  // One queued batch: the serialized payload plus (when spooling is on)
+  // the raw records so a failed delivery can still reach flash
+  struct TxBatch
+  {
+    String *payload;
+    SpoolRecord *records;
+    u16_t recordCount;
+  };
+  static void _txTaskLoop(void *arg)
+  {
+    ESPLogger *logger = static_cast<ESPLogger *>(arg);
+    TxBatch batch;
+    for (;;)
+    {
+      if (xQueueReceive(logger->_txQueue, &batch, portMAX_DELAY) != pdTRUE)
+      {
+        continue;
+      }
+      bool delivered;
+      if (batch.payload)
+      {
+        delivered = logger->_transmitBatch(*batch.payload);
+      }
+      else
+      {
+        // Pipelined JSON batch: serialization happens here, on the
+        // transmission core, while the loop core keeps sampling
+        String payload;
+        payload.reserve(logger->_payloadHighWater ? logger->_payloadHighWater : LOGGER_PAYLOAD_RESERVE);
+        u32_t serializeStart = micros();
+        logger->_buildRecordsPayload(batch.records, batch.recordCount, payload);
+        u32_t serializeMicros = micros() - serializeStart;
+        // Counters are shared with the loop core; write them under the
+        // mutex both cores already hold around HTTP work
+        logger->_lockHttp();
+        logger->_metrics.lastSerializeMicros = serializeMicros;
+        logger->_metrics.totalSerializeMicros += serializeMicros;
+        logger->_metrics.lastPayloadBytes = payload.length();
+        if (payload.length() > logger->_payloadHighWater)
+        {
+          logger->_payloadHighWater = payload.length();
+        }
+        logger->_unlockHttp();
+        delivered = logger->_transmitBatch(payload);
+      }
+      logger->_lockHttp();
+      logger->_noteBatchOutcome(delivered);
+      if (!delivered && batch.records && logger->_spoolEnabled)
+      {
+        logger->_spool.append(batch.records, batch.recordCount);
+      }
+      logger->_unlockHttp();
+      delete batch.payload;
+      delete[] batch.records;
+      if (logger->_onDelivery)
+      {
+        logger->_onDelivery(delivered);
+      }
+    }
+  }
+  // Retry state machine run inside the transmission task; blocking here
+  // is fine because only this task waits
+  bool _transmitBatch(const String &payload)
   {
-    if (getUnix() - _lastSensorRead > _sensorReadInterval - _sensorIntervalOffset)
+    const u8_t *body = (const u8_t *)payload.c_str();
+    size_t length = payload.length();
+    bool deflated = false;
+#ifdef LOGGER_ENABLE_DEFLATE
+    u8_t *buffer = nullptr;
+    if (_compress && payload.length() >= LOGGER_COMPRESS_MIN_BYTES)
     {
-      DL_println("Reading sensor values");
-      u32_t timestamp = getUnix();
-      int diff = (((int)timestamp - (int)_lastSensorTimeStamp) - (int)_sensorReadInterval);
-      if (_lastSensorTimeStamp && diff)
+      // Compress once, on this core; every attempt reuses the buffer
+      mz_ulong bound = mz_compressBound(payload.length());
+      buffer = (u8_t *)malloc(bound);
+      if (buffer)
       {
-        _sensorIntervalOffset = min(max((int)0, diff), 5);
+        mz_ulong compressedLength = bound;
+        if (mz_compress2(buffer, &compressedLength, (const unsigned char *)payload.c_str(), payload.length(), MZ_BEST_SPEED) == MZ_OK && compressedLength < payload.length())
+        {
+          DL_printf("Compressed payload %u -> %u bytes\n", payload.length(), (unsigned)compressedLength);
+          body = buffer;
+          length = compressedLength;
+          deflated = true;
+        }
+        else
+        {
+          free(buffer);
+          buffer = nullptr;
+        }
       }
-      DL_printf("Reading sensors on Timestamp: %u\n", timestamp);
-      for (int i = 0; i < NumSensors; i++)
+    }
+#endif
+    bool primaryDelivered = false;
+    for (int ep = 0; ep <= _mirrorCount; ep++)
+    {
+      bool sent = false;
+      for (u8_t attempt = 0; attempt <= LOGGER_TX_RETRIES && !sent; attempt++)
       {
-        if (_sensors[i])
+        if (attempt)
         {
-          _sensors[i]->run(timestamp);
+          _metrics.retries++;
+          vTaskDelay(pdMS_TO_TICKS(LOGGER_TX_BACKOFF_MS << (attempt - 1)));
         }
+        DL_printf("Async send endpoint %i try: %i\n", ep, attempt);
+        sent = ep == 0 ? _sendAttempt(body, length, deflated)
+                       : _sendMirrorAttempt(ep - 1, body, length, deflated);
+      }
+      if (ep == 0)
+      {
+        primaryDelivered = sent;
+      }
+    }
+#ifdef LOGGER_ENABLE_DEFLATE
+    free(buffer);
+#endif
+    return primaryDelivered;
+  }
+  bool _enqueueBatch()
+  {
+    TxBatch batch;
+    batch.payload = nullptr;
+    batch.records = nullptr;
+    batch.recordCount = 0;
+    u16_t total = 0;
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      total += _sensors[_occupied[d]]->_count;
+    }
+    if (_logFormat == LOG_FORMAT_JSON and total)
+    {
+      // Pipelined path: queue the raw records and let the task build
+      // the JSON on its own core. The sampling core pays only for this
+      // drain copy, so batches of any size cannot stall the cadence.
+      batch.records = new SpoolRecord[total];
+      if (!batch.records)
+      {
+        // Readings stay buffered; the next interval retries
+        return false;
+      }
+      u16_t offset = 0;
+      for (u8_t d = 0; d < _sensorCount; d++)
+      {
+        u8_t i = _occupied[d];
+        offset += _sensors[i]->drainTo(batch.records + offset, total - offset, i);
+      }
+      batch.recordCount = offset;
+    }
+    else
+    {
+      // Binary/compact batches (and empty heartbeats) serialize here;
+      // queued payloads are fresh Strings, so start them at the
+      // high-water mark and they grow at most once
+      batch.payload = new String;
+      batch.payload->reserve(_payloadHighWater ? _payloadHighWater : LOGGER_PAYLOAD_RESERVE);
+      _serializeBatch(*batch.payload);
+      if (_spoolEnabled and total)
+      {
+        batch.records = new SpoolRecord[total];
+        if (batch.records)
+        {
+          u16_t offset = 0;
+          for (u8_t d = 0; d < _sensorCount; d++)
+          {
+            u8_t i = _occupied[d];
+            offset += _sensors[i]->drainTo(batch.records + offset, total - offset, i);
+          }
+          batch.recordCount = offset;
+        }
+        else
+        {
+          // Low heap: the payload still goes out, just without the
+          // spool snapshot - same window as running with spooling off
+          _clearSensorReadings();
+        }
+      }
+      else
+      {
+        _clearSensorReadings();
+      }
+    }
+    if (xQueueSend(_txQueue, &batch, 0) != pdTRUE)
+    {
+      DL_println("TX queue full");
+      // The task writes the same counters and spool; take the mutex
+      _lockHttp();
+      _metrics.batchesDropped++;
+      if (batch.records and _spoolEnabled)
+      {
+        _spool.append(batch.records, batch.recordCount);
+      }
+      _unlockHttp();
+      delete batch.payload;
+      delete[] batch.records;
+      return false;
+    }
+    return true;
+  }
+#endif
+  // Secure transport factory: applies the pinned certificate when one
+  // was set, setInsecure() otherwise
+  WiFiClientSecure *_newSecureClient()
+  {
+    WiFiClientSecure *secureClient = new WiFiClientSecure;
+    if (_caCert)
+    {
+      secureClient->setCACert(_caCert);
+    }
+    else
+    {
+      secureClient->setInsecure();
+    }
+    return secureClient;
+  }
+  // Lazily creates the persistent transport used in keep-alive mode
+  WiFiClient *_ensureClient()
+  {
+    if (!_client)
+    {
+      _client = _secure ? _newSecureClient() : new WiFiClient;
+    }
+    return _client;
+  }
+  // Times a connect (TCP + TLS handshake on the secure path) into the
+  // metrics block; a failed connect is left for the caller to handle
+  bool _timedConnect(WiFiClient *client)
+  {
+    u32_t started = micros();
+    bool ok = client->connect(_host.c_str(), _port);
+    if (ok)
+    {
+      _metrics.lastHandshakeMicros = micros() - started;
+      _metrics.totalHandshakeMicros += _metrics.lastHandshakeMicros;
+    }
+    return ok;
+  }
+  // begin() wrapper that routes requests over the held connection when
+  // keep-alive is enabled
+  void _httpBegin(const String &url)
+  {
+    if (_keepAlive)
+    {
+      WiFiClient *client = _ensureClient();
+      // Connect up front so the handshake cost lands in the metrics;
+      // on failure HTTPClient retries the connect itself
+      if (!client->connected())
+      {
+        _timedConnect(client);
       }
-      _lastSensorTimeStamp = timestamp;
-      _lastSensorRead = getUnix();
+      _http->begin(*client, url);
+      _http->addHeader(F("Connection"), F("keep-alive"));
+    }
+    else
+    {
+      _http->begin(url);
+    }
+  }
+  // Recreate the HTTPClient (and drop the held connection) after a
+  // transport-level failure
+  void _resetHttp()
+  {
+    delete _http;
+    _http = new HTTPClient;
+    _http->setReuse(_keepAlive);
+    if (_client)
+    {
+      _client->stop();
+      delete _client;
+      _client = nullptr;
     }
   }
-  bool _sendData(const String &payload)
+  // The HTTPClient is shared between the loop (status, time sync, spool
+  // drain) and the transmission task; serialize access when async is on
+  void _lockHttp()
   {
-    static char retries = 0;
-    DL_printf("Sending data try: %i\n", retries);
-    _http->begin(_logUrl);
+#ifndef LOGGER_NATIVE
+    if (_httpMutex)
+    {
+      xSemaphoreTake(_httpMutex, portMAX_DELAY);
+    }
+#endif
+  }
+  void _unlockHttp()
+  {
+#ifndef LOGGER_NATIVE
+    if (_httpMutex)
+    {
+      xSemaphoreGive(_httpMutex);
+    }
+#endif
+  }
+  // Serializes the pending batch in the configured wire format and
+  // resets the builder document
+  void _serializeBatch(String &out)
+  {
+    u32_t serializeStart = micros();
+    if (_logFormat == LOG_FORMAT_MSGPACK)
+    {
+      JsonDocument doc;
+      _buildCompactDoc(doc);
+      serializeMsgPack(doc, out);
+    }
+    else
+    {
+      serializeJson(_device, out);
+    }
+    _resetJSON();
+    _metrics.lastSerializeMicros = micros() - serializeStart;
+    _metrics.totalSerializeMicros += _metrics.lastSerializeMicros;
+    _metrics.lastPayloadBytes = out.length();
+    if (out.length() > _payloadHighWater)
+    {
+      _payloadHighWater = out.length();
+      // Grow the reusable buffer once; steady state then serializes
+      // into capacity that is already there
+      reservePayload(_payloadHighWater);
+    }
+  }
+  // Compact batch layout for the binary wire format: metadata was
+  // registered by the status payload, so batches carry only
+  // [sensor-index, timestamp-delta, value] tuples (first tuple of each
+  // sensor carries the absolute timestamp)
+  void _buildCompactDoc(JsonDocument &doc)
+  {
+    doc[F("device_id")] = _deviceId;
+    JsonArray readings = doc[F("readings")].to<JsonArray>();
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      u8_t i = _occupied[d];
+      Sensor *sensor = _sensors[i];
+      if (sensor->_aggregate)
+      {
+        // Aggregates travel as one mean tuple in the compact format
+        if (sensor->_aggCount)
+        {
+          JsonArray tuple = readings.add<JsonArray>();
+          tuple.add(i);
+          tuple.add(sensor->_aggTimestamp);
+          tuple.add(sensor->_aggSum / sensor->_aggCount);
+        }
+        continue;
+      }
+      u16_t index = (sensor->_head + LOGGER_SENSOR_BUFFER_SIZE - sensor->_count) % LOGGER_SENSOR_BUFFER_SIZE;
+      u32_t lastTimestamp = 0;
+      for (u16_t r = 0; r < sensor->_count; r++)
+      {
+        JsonArray tuple = readings.add<JsonArray>();
+        tuple.add(i);
+        tuple.add(sensor->_timestampAt(index) - lastTimestamp);
+        if (sensor->_quantStep > 0)
+        {
+          // Quantized sensors pack as integer step counts; the step
+          // was registered with the sensor metadata
+          tuple.add((int32_t)lroundf(sensor->_values[index] / sensor->_quantStep));
+        }
+        else
+        {
+          tuple.add(sensor->_values[index]);
+        }
+        lastTimestamp = sensor->_timestampAt(index);
+        index = (index + 1) % LOGGER_SENSOR_BUFFER_SIZE;
+      }
+    }
+  }
+  // Status payload: device identity plus per-sensor metadata with the
+  // slot index that compact binary batches reference
+  void _buildStatusPayload(String &out)
+  {
+    JsonDocument doc = _device;
+    JsonArray sensors = doc[F("sensors")].to<JsonArray>();
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      u8_t i = _occupied[d];
+      JsonObject sensorObj = sensors.add<JsonObject>();
+      sensorObj[F("index")] = i;
+      sensorObj[F("name")] = _sensors[i]->name();
+      sensorObj[F("unit")] = _sensors[i]->unit();
+      sensorObj[F("sensor_type")] = _sensors[i]->type();
+      if (_sensors[i]->_quantStep > 0)
+      {
+        // Lets the server scale integer compact tuples back to units
+        sensorObj[F("quant_step")] = _sensors[i]->_quantStep;
+      }
+    }
+    if (_metricsInStatus)
+    {
+      JsonObject metrics = doc[F("metrics")].to<JsonObject>();
+      metrics[F("batches_sent")] = _metrics.batchesSent;
+      metrics[F("retries")] = _metrics.retries;
+      metrics[F("batches_dropped")] = _metrics.batchesDropped;
+      metrics[F("last_payload_bytes")] = _metrics.lastPayloadBytes;
+      metrics[F("last_post_micros")] = _metrics.lastPostMicros;
+      metrics[F("last_serialize_micros")] = _metrics.lastSerializeMicros;
+      metrics[F("last_handshake_micros")] = _metrics.lastHandshakeMicros;
+      metrics[F("free_heap")] = ESP.getFreeHeap();
+      metrics[F("max_alloc_block")] = ESP.getMaxAllocHeap();
+    }
+    serializeJson(doc, out);
+  }
+  void _clearSensorReadings()
+  {
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      _sensors[_occupied[d]]->clearReadings();
+    }
+  }
+  // Drain everything the just-serialized batch covers into
+  // _pendingRecords (see the TRANSMIT settle paths). If the allocation
+  // fails the readings simply stay buffered and ride along with the
+  // next batch - duplicates over data loss.
+  void _takePendingRecords()
+  {
+    _dropPendingRecords();
+    u16_t total = 0;
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      Sensor *sensor = _sensors[_occupied[d]];
+      total += sensor->_aggregate ? (sensor->_aggCount ? 1 : 0) : sensor->_count;
+    }
+    if (!total)
+    {
+      return;
+    }
+    SpoolRecord *records = new SpoolRecord[total];
+    if (!records)
+    {
+      return;
+    }
+    u16_t offset = 0;
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      u8_t i = _occupied[d];
+      offset += _sensors[i]->drainTo(records + offset, total - offset, i);
+    }
+    _pendingRecords = records;
+    _pendingRecordCount = offset;
+  }
+  void _dropPendingRecords()
+  {
+    delete[] _pendingRecords;
+    _pendingRecords = nullptr;
+    _pendingRecordCount = 0;
+  }
+  void _spoolReadings()
+  {
+    SpoolRecord records[LOGGER_SPOOL_DRAIN_RECORDS];
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      u8_t i = _occupied[d];
+      u16_t drained;
+      while ((drained = _sensors[i]->drainTo(records, LOGGER_SPOOL_DRAIN_RECORDS, i)) > 0)
+      {
+        if (!_spool.append(records, drained))
+        {
+          DL_println("Spool append failed, dropping readings");
+          _sensors[i]->clearReadings();
+          break;
+        }
+      }
+    }
+  }
+  // Replays a bounded slice of the spool per tick so the loop never
+  // stalls on flash I/O or a large backlog
+  void _drainSpool()
+  {
+    if (!_spoolEnabled || !_spool.pending())
+    {
+      return;
+    }
+    if (WiFi.status() != WL_CONNECTED || getUnix() - _lastDrain < LOGGER_SPOOL_DRAIN_INTERVAL)
+    {
+      return;
+    }
+    _lastDrain = getUnix();
+    SpoolRecord records[LOGGER_SPOOL_DRAIN_RECORDS];
+    size_t count = _spool.peek(records, LOGGER_SPOOL_DRAIN_RECORDS);
+    if (!count)
+    {
+      return;
+    }
+    DL_printf("Draining %u spooled readings\n", (unsigned)count);
+    String payload;
+    _buildRecordsPayload(records, count, payload);
+    if (_postPayload(payload))
+    {
+      _spool.commit(count);
+    }
+  }
+  // Builds a /log payload from raw records - replayed spool entries or
+  // a queued pipeline batch. Same document shape as the live batch, but
+  // readings carry absolute timestamps since records from different
+  // wakes share no base.
+  void _buildRecordsPayload(const SpoolRecord *records, size_t count, String &out)
+  {
+    JsonDocument doc;
+    doc[F("device_id")] = _deviceId;
+    doc[F("device_name")] = _deviceName;
+    doc[F("group_name")] = _deviceGroup;
+    doc[F("firmware_version")] = _firmwareVersion;
+    JsonArray sensors = doc[F("sensors")].to<JsonArray>();
+    for (u8_t d = 0; d < _sensorCount; d++)
+    {
+      u8_t i = _occupied[d];
+      JsonArray values;
+      bool present = false;
+      for (size_t r = 0; r < count; r++)
+      {
+        if (records[r].sensorIndex != i)
+        {
+          continue;
+        }
+        if (!present)
+        {
+          JsonObject sensorObj = sensors.add<JsonObject>();
+          sensorObj[F("name")] = _sensors[i]->name();
+          sensorObj[F("unit")] = _sensors[i]->unit();
+          sensorObj[F("sensor_type")] = _sensors[i]->type();
+          values = sensorObj[F("sensor_values")].to<JsonArray>();
+          present = true;
+        }
+        JsonObject reading = values.add<JsonObject>();
+        if (_sensors[i]->_quantStep > 0)
+        {
+          reading[F("value")] = serialized(String(records[r].value, _sensors[i]->_quantDecimals));
+        }
+        else
+        {
+          reading[F("value")] = records[r].value;
+        }
+        reading[F("timestamp")] = records[r].timestamp;
+      }
+    }
+    serializeJson(doc, out);
+  }
+  // Single-attempt POST to the log endpoint; retries are left to the
+  // next drain cycle
+  bool _postPayload(const String &payload)
+  {
+    _lockHttp();
+    _httpBegin(_logUrl);
     _http->addHeader(F("Content-Type"), F("application/json"));
     _http->addHeader(F("Authorization"), _apiKey);
-    _resetJSON();
     int httpCode = _http->POST(payload);
+    DL_printf("Spool drain HTTP Code: %d\n", httpCode);
+    _http->end();
+    _unlockHttp();
+    return httpCode == 201;
+  }
+  // Streamed variant of _sendData: opens the socket itself, writes the
+  // headers, then lets serializeJson write the body straight into the
+  // WiFiClient so the payload never exists as one in-RAM buffer.
+  bool _sendDataStreamed()
+  {
+    for (char attempt = 0; attempt <= 3; attempt++)
+    {
+      DL_printf("Sending data (streamed) try: %i\n", attempt);
+      WiFiClient *client = _secure ? _newSecureClient() : new WiFiClient;
+      if (!_timedConnect(client))
+      {
+        DL_println("Streamed connect failed");
+        delete client;
+        delay(5);
+        continue;
+      }
+      size_t contentLength = measureJson(_device);
+      client->print(F("POST "));
+      client->print(_logPath);
+      client->println(F(" HTTP/1.1"));
+      client->print(F("Host: "));
+      client->println(_host);
+      client->println(F("Content-Type: application/json"));
+      client->print(F("Authorization: "));
+      client->println(_apiKey);
+      client->print(F("Content-Length: "));
+      client->println(contentLength);
+      client->println(F("Connection: close"));
+      client->println();
+      serializeJson(_device, *client);
+      client->flush();
+      // Status line looks like: HTTP/1.1 201 Created
+      String statusLine = client->readStringUntil('\n');
+      int httpCode = 0;
+      int space = statusLine.indexOf(' ');
+      if (space > 0)
+      {
+        httpCode = statusLine.substring(space + 1).toInt();
+      }
+      DL_printf("Send data HTTP Code: %d\n", httpCode);
+      if (httpCode == 201)
+      {
+        // Skip response headers, then parse the body from the stream
+        while (client->connected())
+        {
+          String line = client->readStringUntil('\n');
+          if (line == "\r" || line.length() == 0)
+          {
+            break;
+          }
+        }
+        JsonDocument doc;
+        JsonDocument filter;
+        filter[F("notice")] = true;
+        filter[F("firmware_id")] = true;
+        deserializeJson(doc, *client, DeserializationOption::Filter(filter));
+        client->stop();
+        delete client;
+        _resetJSON();
+        handleNotice(doc);
+        if (millis() - _lastUnix > ONE_DAY)
+          _syncTime();
+        return true;
+      }
+      client->stop();
+      delete client;
+      delay(5);
+    }
+    _resetJSON();
+    return false;
+  }
+  // Log interval currently in force. Consecutive delivery failures
+  // double it (capped at LOGGER_INTERVAL_BACKOFF_MAX x) and add a
+  // device-id-derived jitter slice so a fleet recovering from the same
+  // outage does not hit the server in lockstep; an explicit Retry-After
+  // from the server wins when it asks for more.
+  u32_t _effectiveLogInterval()
+  {
+    u32_t interval = _logInterval;
+    if (_intervalBackoff)
+    {
+      u32_t factor = 1u << _intervalBackoff;
+      if (factor > LOGGER_INTERVAL_BACKOFF_MAX)
+      {
+        factor = LOGGER_INTERVAL_BACKOFF_MAX;
+      }
+      interval *= factor;
+      interval += _deviceId % (_logInterval + 1);
+    }
+    if (_retryAfter > interval)
+    {
+      interval = _retryAfter;
+    }
+    return interval;
+  }
+  void _noteBatchOutcome(bool delivered)
+  {
+    if (delivered)
+    {
+      _metrics.batchesSent++;
+      _intervalBackoff = 0;
+      _retryAfter = 0;
+    }
+    else if ((1u << _intervalBackoff) < LOGGER_INTERVAL_BACKOFF_MAX)
+    {
+      _intervalBackoff++;
+    }
+  }
+  // Releases per-batch transmit state once the batch is delivered,
+  // spooled or dropped
+  void _finishTransmit()
+  {
+    _payload.clear();
+    _nextAttemptMs = 0;
+    if (_compressed)
+    {
+      free(_compressed);
+      _compressed = nullptr;
+      _compressedLength = 0;
+    }
+  }
+  // POST to a mirror endpoint. Mirrors get no response processing (no
+  // notices, no time sync) - the primary endpoint drives those.
+  bool _sendMirrorAttempt(u8_t mirror, const u8_t *body, size_t length, bool deflated)
+  {
+    _lockHttp();
+    _http->begin(_mirrors[mirror].logUrl);
+    _http->addHeader(F("Content-Type"), _logFormat == LOG_FORMAT_MSGPACK ? F("application/msgpack") : F("application/json"));
+    if (deflated)
+    {
+      _http->addHeader(F("Content-Encoding"), F("deflate"));
+    }
+    _http->addHeader(F("Authorization"), _mirrors[mirror].apiKey.length() ? _mirrors[mirror].apiKey : _apiKey);
+    int httpCode = _http->POST((uint8_t *)body, length);
+    DL_printf("Mirror %u HTTP Code: %d\n", mirror, httpCode);
+    _http->end();
+    _unlockHttp();
+    return httpCode == 201;
+  }
+  // One POST to the log endpoint, no retries; shared by the synchronous
+  // path and the async transmission task
+  bool _sendAttempt(const u8_t *body, size_t length, bool deflated)
+  {
+    static const char *collected[] = {"Retry-After"};
+    _lockHttp();
+    _httpBegin(_logUrl);
+    _http->collectHeaders(collected, 1);
+    _http->addHeader(F("Content-Type"), _logFormat == LOG_FORMAT_MSGPACK ? F("application/msgpack") : F("application/json"));
+    if (deflated)
+    {
+      _http->addHeader(F("Content-Encoding"), F("deflate"));
+    }
+    _http->addHeader(F("Authorization"), _apiKey);
+    u32_t postStart = micros();
+    int httpCode = _http->POST((uint8_t *)body, length);
+    _metrics.lastPostMicros = micros() - postStart;
+    _metrics.totalPostMicros += _metrics.lastPostMicros;
     DL_printf("Send data HTTP Code: %d\n", httpCode);
-
     if (httpCode == 201)
     {
-      retries = 0;
-      if (millis() - _lastUnix > ONE_DAY)
-        _syncTime();
-      String response = _http->getString();
-      DL_printf("Response: %s\n", response.c_str());
+      u32_t parseStart = micros();
       JsonDocument doc;
-      deserializeJson(doc, response);
-      handleNotice(doc);
+      _parseResponse(doc);
+      _metrics.lastParseMicros = micros() - parseStart;
+      _metrics.totalParseMicros += _metrics.lastParseMicros;
       _http->end();
+      _unlockHttp();
+      handleNotice(doc);
+      if (millis() - _lastUnix > ONE_DAY)
+        _syncTime();
       return true;
     }
-    else
+    if (httpCode == 429 or httpCode == 503)
     {
-      _http->end();
-      if (retries < 3)
-      {
-        retries++;
-        delay(5);
-        return _sendData(payload);
-      }
-      else
+      // Explicit backpressure; seconds form only, HTTP-dates are ignored
+      _retryAfter = _http->header(collected[0]).toInt();
+      DL_printf("Server asked to retry after %u s\n", _retryAfter);
+    }
+    _http->end();
+    if (httpCode == -1 and _http)
+    {
+      _resetHttp();
+    }
+    _unlockHttp();
+    return false;
+  }
+  // Parse a server reply without materializing it: deserialize straight
+  // from the HTTP stream with a filter, so only the keys the logger
+  // ever reads (notice, firmware_id, unix_time) are allocated. Memory
+  // cost is then bounded by those fields, not the response size - a
+  // verbose reply cannot blow the heap mid-exchange. Call between the
+  // request and _http->end(); transports without a live stream (the
+  // host mock) fall back to getString with the same filter.
+  void _parseResponse(JsonDocument &doc)
+  {
+    JsonDocument filter;
+    filter[F("notice")] = true;
+    filter[F("firmware_id")] = true;
+    filter[F("unix_time")] = true;
+    WiFiClient *stream = _http->getStreamPtr();
+    if (stream and _http->getSize() > 0)
+    {
+      deserializeJson(doc, *stream, DeserializationOption::Filter(filter));
+      if (_keepAlive)
       {
-        if (httpCode == -1 and _http)
+        // The filtered parse may stop before the body's last byte; a
+        // held connection must not carry leftovers into the next
+        // request
+        while (stream->available())
         {
-          _http->end();
-          delete _http;
-          _http = new HTTPClient;
+          stream->read();
         }
-        retries = 0;
-        return false;
       }
     }
+    else
+    {
+      // Chunked replies (no Content-Length) would feed chunk framing
+      // into the parser; getString() de-chunks them first. Also the
+      // path for transports without a live stream (the host mock).
+      String response = _http->getString();
+      deserializeJson(doc, response, DeserializationOption::Filter(filter));
+    }
   }
   void handleNotice(JsonDocument &doc)
   {
@@ -408,54 +2437,186 @@ private:
       _updateFirmware(_downloadUrl + firmware_id);
     }
   }
+  // Streams a firmware image into the OTA partition with HTTP Range
+  // resume: a dropped connection re-requests "bytes=<written>-" and
+  // keeps writing where it left off instead of restarting the image.
+  // Resume only spans connection drops within one update session; the
+  // OTA partition cannot be re-opened mid-write after a reset, so a
+  // reboot starts the download over.
   bool _updateFirmware(const String &downloadUrl = "")
   {
+#ifdef LOGGER_NATIVE
+    // OTA needs the real flash partitions; host builds just refuse
+    (void)downloadUrl;
+    return false;
+#else
     DL_printf("Updating firmware from: %s\n", downloadUrl.c_str());
-    _http->begin(downloadUrl);
-    _http->addHeader(F("Authorization"), _apiKey);
-
-    DL_println("Updating firmware");
-    t_httpUpdate_return ret = httpUpdate.update(*_http);
-
-    switch (ret)
+    if (_onUpdateStart)
     {
-    case HTTP_UPDATE_FAILED:
-      DL_printf("HTTP_UPDATE_FAILED Error (%d): %s\n", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
-      return false;
-      break;
-
-    case HTTP_UPDATE_NO_UPDATES:
-      DL_println("HTTP_UPDATE_NO_UPDATES");
-      return false;
-      break;
-
-    case HTTP_UPDATE_OK:
-      DL_println("HTTP_UPDATE_OK");
-      return true;
-      break;
-    default:
-      return false;
-      break;
+      _onUpdateStart();
     }
+    size_t written = 0;
+    size_t totalSize = 0;
+    for (u8_t attempt = 0; attempt <= LOGGER_OTA_RESUMES; attempt++)
+    {
+      _lockHttp();
+      _http->begin(downloadUrl);
+      _http->addHeader(F("Authorization"), _apiKey);
+      if (written)
+      {
+        _http->addHeader(F("Range"), String(F("bytes=")) + written + "-");
+      }
+      int httpCode = _http->GET();
+      DL_printf("Firmware download HTTP Code: %d\n", httpCode);
+      if (httpCode != 200 and httpCode != 206)
+      {
+        _http->end();
+        _unlockHttp();
+        continue;
+      }
+      if (!written)
+      {
+        int size = _http->getSize();
+        if (size <= 0 or !Update.begin(size))
+        {
+          DL_printf("Update begin failed: %s\n", Update.errorString());
+          _http->end();
+          _unlockHttp();
+          return false;
+        }
+        totalSize = size;
+      }
+      else if (httpCode == 200)
+      {
+        // Server ignored the Range header and restarted from byte 0
+        Update.abort();
+        if (!Update.begin(totalSize))
+        {
+          DL_printf("Update begin failed: %s\n", Update.errorString());
+          _http->end();
+          _unlockHttp();
+          return false;
+        }
+        written = 0;
+      }
+      WiFiClient *stream = _http->getStreamPtr();
+      u8_t buffer[1024];
+      u32_t lastData = millis();
+      while (written < totalSize and (stream->connected() or stream->available()))
+      {
+        size_t available = stream->available();
+        if (!available)
+        {
+          if (millis() - lastData > LOGGER_OTA_STALL_MS)
+          {
+            break;
+          }
+          delay(1);
+          continue;
+        }
+        if (available > sizeof(buffer))
+        {
+          available = sizeof(buffer);
+        }
+        int bytes = stream->readBytes(buffer, available);
+        if (bytes <= 0)
+        {
+          break;
+        }
+        if (Update.write(buffer, bytes) != (size_t)bytes)
+        {
+          DL_printf("Update write failed: %s\n", Update.errorString());
+          Update.abort();
+          _http->end();
+          _unlockHttp();
+          return false;
+        }
+        written += bytes;
+        lastData = millis();
+      }
+      _http->end();
+      _unlockHttp();
+      if (written >= totalSize)
+      {
+        if (!Update.end(true))
+        {
+          DL_printf("Update end failed: %s\n", Update.errorString());
+          return false;
+        }
+        DL_println("HTTP_UPDATE_OK");
+        if (_onUpdateEnd)
+        {
+          _onUpdateEnd();
+        }
+        ESP.restart();
+        return true;
+      }
+      DL_printf("Download interrupted at %u/%u, resuming\n", written, totalSize);
+    }
+    DL_println("HTTP_UPDATE_FAILED");
+    Update.abort();
+    return false;
+#endif
+  }
+  // FNV-1a over the serialized payload; cheap, no tables, and stable
+  // across boots as long as the document content is
+  u32_t _fnv1a(const String &payload)
+  {
+    u32_t hash = 2166136261ul;
+    for (unsigned int i = 0; i < payload.length(); i++)
+    {
+      hash ^= (u8_t)payload[i];
+      hash *= 16777619ul;
+    }
+    return hash;
+  }
+  // Status-hash persistence in NVS; 0 doubles as "no cached hash" (an
+  // actual 0 hash just costs one redundant POST). Native builds have no
+  // NVS and always send.
+  u32_t _loadStatusHash()
+  {
+#ifndef LOGGER_NATIVE
+    Preferences prefs;
+    if (!prefs.begin(LOGGER_NVS_NAMESPACE, true))
+    {
+      return 0;
+    }
+    u32_t hash = prefs.getUInt("statusHash", 0);
+    prefs.end();
+    return hash;
+#else
+    return 0;
+#endif
+  }
+  void _storeStatusHash(u32_t hash)
+  {
+#ifndef LOGGER_NATIVE
+    Preferences prefs;
+    if (prefs.begin(LOGGER_NVS_NAMESPACE, false))
+    {
+      prefs.putUInt("statusHash", hash);
+      prefs.end();
+    }
+#endif
   }
   bool _sendStatus(const String &payload)
   {
     DL_println("Sending status");
     DL_printf("Connecting to: %s\n", _statusUrl.c_str());
-    _http->begin(_statusUrl);
+    _lockHttp();
+    _httpBegin(_statusUrl);
     _http->addHeader(F("Content-Type"), F("application/json"));
     _http->addHeader(F("Authorization"), _apiKey);
     int httpCode = _http->POST(payload);
     DL_printf("Send status HTTP Code: %d\n", httpCode);
     if (httpCode == 200)
     {
-      String response = _http->getString();
-      DL_printf("Response: %s\n", response.c_str());
       JsonDocument doc;
-      deserializeJson(doc, response);
+      _parseResponse(doc);
+      _http->end();
+      _unlockHttp();
       _syncTime(doc[F("unix_time")]);
       handleNotice(doc);
-      _http->end();
       return true;
     }
     else
@@ -463,20 +2624,20 @@ private:
       _http->end();
       if (httpCode == -1 and _http)
       {
-        delete _http;
-        _http = new HTTPClient;
+        _resetHttp();
       }
+      _unlockHttp();
       return false;
     }
   }
-  bool _syncTime(const String &unix = "")
+  bool _syncTime(const String &unixTime = "")
   {
-    if (unix != "")
+    if (unixTime != "")
     {
-      _unix = unix.toInt();
+      _unix = unixTime.toInt();
       _lastUnix = millis();
       _lastLog = _unix;
-      _lastSensorRead = _unix;
+      _nextSensorDue = 0;
       return true;
     }
     // If WiFi mode is set to AP return false
@@ -484,10 +2645,30 @@ private:
     {
       return false;
     }
+    if (_useSntp)
+    {
+      _startSntp();
+      time_t now = time(nullptr);
+      if ((u32_t)now > LOGGER_EPOCH_VALID)
+      {
+        DL_printf("Time from SNTP: %u\n", (u32_t)now);
+        _unix = now;
+        _lastUnix = millis();
+        _lastLog = _unix;
+        _nextSensorDue = 0;
+        return true;
+      }
+      if (millis() - _sntpStartMs < LOGGER_SNTP_GRACE_MS)
+      {
+        // SNTP answer still in flight; skip the expensive HTTP fallback
+        return false;
+      }
+    }
     DL_printf("Syncing time\n");
     //  WiFiClient client;
     DL_printf("Connecting to: %s\n", _timeUrl.c_str());
-    _http->begin(_timeUrl);
+    _lockHttp();
+    _httpBegin(_timeUrl);
     DL_printf("Adding headers\n");
     _http->addHeader(F("Content-Type"), F("application/json"));
     _http->addHeader(F("Authorization"), _apiKey);
@@ -497,18 +2678,14 @@ private:
     DL_printf("Sync time HTTP Code: %d\n", httpCode);
     if (httpCode == 200)
     {
-      String payload = _http->getString();
-
-      DL_printf("Payload: %s\n", payload.c_str());
       JsonDocument doc;
-      DL_printf("Deserializing\n");
-      deserializeJson(doc, payload);
-      DL_printf("Deserialized\n");
+      _parseResponse(doc);
       _unix = doc[F("unix_time")];
       _lastUnix = millis();
       _lastLog = _unix;
-      _lastSensorRead = _unix;
+      _nextSensorDue = 0;
       _http->end();
+      _unlockHttp();
       return true;
     }
     else
@@ -516,17 +2693,30 @@ private:
       _http->end();
       if (httpCode == -1 and _http)
       {
-        delete _http;
-        _http = new HTTPClient;
+        _resetHttp();
       }
+      _unlockHttp();
       return false;
     }
   }
+  void _startSntp()
+  {
+    if (!_useSntp || _sntpStarted)
+    {
+      return;
+    }
+    configTime(0, 0, _sntpServer);
+    _sntpStarted = true;
+    _sntpStartMs = millis();
+  }
   void _setUrl(const String &url)
   {
     String _prefix = F("https://");
     if (!_secure)
       _prefix = F("http://");
+    _host = url;
+    _port = _secure ? 443 : 80;
+    _logPath = String(API_SUFFIX) + LOG_PATH;
     _logUrl = _prefix + url + API_SUFFIX + LOG_PATH;
     _timeUrl = _prefix + url + API_SUFFIX + TIME_PATH;
     _downloadUrl = _prefix + url + API_SUFFIX + FIRMWARE_PATH;
@@ -0,0 +1,207 @@
+#ifndef LOGGER_SPOOL_H
+#define LOGGER_SPOOL_H
+#include <Arduino.h>
+#ifndef LOGGER_NATIVE
+#include <LittleFS.h>
+#endif
+#define SPOOL_FILE "/esplogger.spool"
+#define SPOOL_MAGIC 0x53504C31UL // "SPL1"
+#define SPOOL_HEADER_SIZE 8
+
+// One spooled reading. Fixed-width binary on purpose: flash wear and
+// write latency stay low compared to spooling serialized JSON.
+struct SpoolRecord
+{
+  u8_t sensorIndex;
+  u32_t timestamp;
+  float value;
+} __attribute__((packed));
+
+#ifdef LOGGER_NATIVE
+// Host builds have no LittleFS; the spool reports itself unavailable so
+// enableSpool() fails cleanly and the logger falls back to dropping
+// undeliverable batches, same as a device whose flash mount failed.
+class LoggerSpool
+{
+public:
+  bool begin(size_t maxBytes = 65536)
+  {
+    (void)maxBytes;
+    return false;
+  }
+  size_t pending() { return 0; }
+  bool append(const SpoolRecord *, size_t) { return false; }
+  size_t peek(SpoolRecord *, size_t) { return 0; }
+  bool commit(size_t) { return false; }
+  void clear() {}
+};
+#else
+// Append-log of SpoolRecords on LittleFS for readings that failed to
+// send. Records drain oldest-first; the read cursor lives in the file
+// header so progress survives resets without rewriting record data.
+class LoggerSpool
+{
+public:
+  // Mounts LittleFS (formatting on first use) and validates the log.
+  // - maxBytes: cap on spool file size; appends are refused beyond it
+  bool begin(size_t maxBytes = 65536)
+  {
+    _maxBytes = maxBytes;
+    if (!LittleFS.begin(true))
+    {
+      return false;
+    }
+    File file = LittleFS.open(SPOOL_FILE, "r");
+    if (file)
+    {
+      u32_t magic = 0;
+      file.read((u8_t *)&magic, sizeof(magic));
+      file.read((u8_t *)&_readOffset, sizeof(_readOffset));
+      _size = file.size();
+      file.close();
+      if (magic != SPOOL_MAGIC || _readOffset > _size)
+      {
+        clear();
+      }
+    }
+    else
+    {
+      _size = 0;
+      _readOffset = 0;
+    }
+    _ready = true;
+    return true;
+  }
+  size_t pending()
+  {
+    if (!_ready || _size <= SPOOL_HEADER_SIZE)
+      return 0;
+    u32_t offset = _readOffset < SPOOL_HEADER_SIZE ? SPOOL_HEADER_SIZE : _readOffset;
+    return (_size - offset) / sizeof(SpoolRecord);
+  }
+  bool append(const SpoolRecord *records, size_t count)
+  {
+    if (!_ready || !count)
+      return false;
+    size_t bytes = count * sizeof(SpoolRecord);
+    if (_size + bytes > _maxBytes)
+    {
+      // Reclaim the committed prefix before giving up
+      if (!_compact() || _size + bytes > _maxBytes)
+      {
+        return false;
+      }
+    }
+    File file = LittleFS.open(SPOOL_FILE, _size ? "r+" : "w+");
+    if (!file)
+      return false;
+    if (!_size)
+    {
+      u32_t magic = SPOOL_MAGIC;
+      u32_t offset = SPOOL_HEADER_SIZE;
+      file.write((const u8_t *)&magic, sizeof(magic));
+      file.write((const u8_t *)&offset, sizeof(offset));
+      _size = SPOOL_HEADER_SIZE;
+      _readOffset = SPOOL_HEADER_SIZE;
+    }
+    file.seek(_size);
+    size_t written = file.write((const u8_t *)records, bytes);
+    file.close();
+    _size += written;
+    return written == bytes;
+  }
+  // Reads up to maxRecords oldest records without consuming them;
+  // call commit() once they have been delivered.
+  size_t peek(SpoolRecord *out, size_t maxRecords)
+  {
+    size_t available = pending();
+    if (!available)
+      return 0;
+    if (maxRecords > available)
+      maxRecords = available;
+    File file = LittleFS.open(SPOOL_FILE, "r");
+    if (!file)
+      return 0;
+    u32_t offset = _readOffset < SPOOL_HEADER_SIZE ? SPOOL_HEADER_SIZE : _readOffset;
+    file.seek(offset);
+    size_t bytes = file.read((u8_t *)out, maxRecords * sizeof(SpoolRecord));
+    file.close();
+    return bytes / sizeof(SpoolRecord);
+  }
+  // Advances the read cursor past count delivered records. Only the
+  // 4-byte cursor is rewritten, never the record data.
+  bool commit(size_t count)
+  {
+    if (!_ready || !count)
+      return false;
+    _readOffset += count * sizeof(SpoolRecord);
+    if (_readOffset >= _size)
+    {
+      clear();
+      return true;
+    }
+    File file = LittleFS.open(SPOOL_FILE, "r+");
+    if (!file)
+      return false;
+    file.seek(4);
+    file.write((const u8_t *)&_readOffset, sizeof(_readOffset));
+    file.close();
+    return true;
+  }
+  void clear()
+  {
+    LittleFS.remove(SPOOL_FILE);
+    _size = 0;
+    _readOffset = 0;
+  }
+
+private:
+  // Copies the unread tail to a fresh file so committed bytes are
+  // reclaimed. Only runs when an append would exceed maxBytes.
+  bool _compact()
+  {
+    size_t available = pending();
+    if (_readOffset <= SPOOL_HEADER_SIZE)
+      return false;
+    if (!available)
+    {
+      clear();
+      return true;
+    }
+    File src = LittleFS.open(SPOOL_FILE, "r");
+    File dst = LittleFS.open(SPOOL_FILE ".tmp", "w+");
+    if (!src || !dst)
+    {
+      if (src)
+        src.close();
+      if (dst)
+        dst.close();
+      return false;
+    }
+    u32_t magic = SPOOL_MAGIC;
+    u32_t offset = SPOOL_HEADER_SIZE;
+    dst.write((const u8_t *)&magic, sizeof(magic));
+    dst.write((const u8_t *)&offset, sizeof(offset));
+    src.seek(_readOffset);
+    u8_t buffer[128];
+    int bytes;
+    while ((bytes = src.read(buffer, sizeof(buffer))) > 0)
+    {
+      dst.write(buffer, bytes);
+    }
+    size_t newSize = dst.size();
+    src.close();
+    dst.close();
+    LittleFS.remove(SPOOL_FILE);
+    LittleFS.rename(SPOOL_FILE ".tmp", SPOOL_FILE);
+    _size = newSize;
+    _readOffset = SPOOL_HEADER_SIZE;
+    return true;
+  }
+  bool _ready = false;
+  u32_t _readOffset = 0;
+  size_t _size = 0;
+  size_t _maxBytes = 0;
+};
+#endif
+#endif
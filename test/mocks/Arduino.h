@@ -0,0 +1,303 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+// Host-side stand-in for the Arduino core, just enough surface for
+// Logger.h and ArduinoJson to compile and run in the native test
+// environment (pio test -e native). Time is the host steady clock plus
+// a test-controlled offset so benchmarks can fast-forward schedules.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#include <string>
+#include <algorithm>
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef uint64_t u64_t;
+typedef uint32_t u_int32_t;
+
+using std::max;
+using std::min;
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*reinterpret_cast<const uint8_t *>(p))
+#define pgm_read_word(p) (*reinterpret_cast<const uint16_t *>(p))
+#define pgm_read_dword(p) (*reinterpret_cast<const uint32_t *>(p))
+#define pgm_read_float(p) (*reinterpret_cast<const float *>(p))
+#define pgm_read_ptr(p) (*reinterpret_cast<void *const *>(p))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define RTC_DATA_ATTR
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+// millis()/micros() run on the host steady clock; mockAdvanceMillis
+// shifts both so tests can make log intervals elapse instantly
+inline int64_t &_mockClockOffsetMs()
+{
+  static int64_t offset = 0;
+  return offset;
+}
+inline void mockAdvanceMillis(unsigned long ms)
+{
+  _mockClockOffsetMs() += ms;
+}
+inline int64_t _mockElapsedUs()
+{
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+inline unsigned long millis()
+{
+  return (unsigned long)(_mockElapsedUs() / 1000 + _mockClockOffsetMs());
+}
+inline unsigned long micros()
+{
+  return (unsigned long)(_mockElapsedUs() + _mockClockOffsetMs() * 1000);
+}
+inline void delay(unsigned long) {}
+inline void delayMicroseconds(unsigned int) {}
+inline void configTime(long, int, const char *, const char * = nullptr, const char * = nullptr) {}
+inline uint32_t esp_random()
+{
+  return (uint32_t)rand();
+}
+
+// Arduino String backed by std::string; only the API Logger.h and
+// ArduinoJson touch
+class String
+{
+public:
+  String() {}
+  String(const char *s) : _s(s ? s : "") {}
+  String(const char *s, size_t n) : _s(s, n) {}
+  String(const String &other) : _s(other._s) {}
+  String(const __FlashStringHelper *s) : _s(reinterpret_cast<const char *>(s)) {}
+  String(char c) : _s(1, c) {}
+  String(int value) : _s(std::to_string(value)) {}
+  String(unsigned int value) : _s(std::to_string(value)) {}
+  String(long value) : _s(std::to_string(value)) {}
+  String(unsigned long value) : _s(std::to_string(value)) {}
+  String(long long value) : _s(std::to_string(value)) {}
+  String(unsigned long long value) : _s(std::to_string(value)) {}
+  String(float value, unsigned char decimals = 2)
+  {
+    char buffer[33];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, (double)value);
+    _s = buffer;
+  }
+  String(double value, unsigned char decimals = 2)
+  {
+    char buffer[33];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    _s = buffer;
+  }
+  String &operator=(const String &other)
+  {
+    _s = other._s;
+    return *this;
+  }
+  String &operator=(const char *s)
+  {
+    _s = s ? s : "";
+    return *this;
+  }
+  String &operator=(const __FlashStringHelper *s)
+  {
+    _s = reinterpret_cast<const char *>(s);
+    return *this;
+  }
+  size_t length() const { return _s.length(); }
+  const char *c_str() const { return _s.c_str(); }
+  char charAt(size_t i) const { return _s[i]; }
+  char operator[](size_t i) const { return _s[i]; }
+  bool reserve(size_t n)
+  {
+    _s.reserve(n);
+    return true;
+  }
+  void clear() { _s.clear(); }
+  bool isEmpty() const { return _s.empty(); }
+  bool concat(const char *s, size_t n)
+  {
+    _s.append(s, n);
+    return true;
+  }
+  bool concat(const String &other)
+  {
+    _s += other._s;
+    return true;
+  }
+  bool concat(char c)
+  {
+    _s += c;
+    return true;
+  }
+  String &operator+=(const String &other)
+  {
+    _s += other._s;
+    return *this;
+  }
+  String &operator+=(const char *s)
+  {
+    _s += s;
+    return *this;
+  }
+  String &operator+=(char c)
+  {
+    _s += c;
+    return *this;
+  }
+  String &operator+=(const __FlashStringHelper *s)
+  {
+    _s += reinterpret_cast<const char *>(s);
+    return *this;
+  }
+  template <typename T>
+  String &operator+=(T value)
+  {
+    _s += String(value)._s;
+    return *this;
+  }
+  friend String operator+(String lhs, const String &rhs)
+  {
+    lhs._s += rhs._s;
+    return lhs;
+  }
+  friend String operator+(String lhs, const char *rhs)
+  {
+    lhs._s += rhs;
+    return lhs;
+  }
+  friend String operator+(String lhs, const __FlashStringHelper *rhs)
+  {
+    lhs._s += reinterpret_cast<const char *>(rhs);
+    return lhs;
+  }
+  friend String operator+(const char *lhs, const String &rhs)
+  {
+    return String(lhs) + rhs;
+  }
+  template <typename T>
+  friend String operator+(String lhs, T rhs)
+  {
+    lhs._s += String(rhs)._s;
+    return lhs;
+  }
+  bool operator==(const String &other) const { return _s == other._s; }
+  bool operator==(const char *s) const { return _s == (s ? s : ""); }
+  bool operator==(const __FlashStringHelper *s) const { return _s == reinterpret_cast<const char *>(s); }
+  bool operator!=(const String &other) const { return _s != other._s; }
+  bool operator!=(const char *s) const { return _s != (s ? s : ""); }
+  int indexOf(char c) const
+  {
+    size_t pos = _s.find(c);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  int indexOf(const char *s) const
+  {
+    size_t pos = _s.find(s);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  String substring(size_t from) const { return String(_s.substr(from).c_str()); }
+  String substring(size_t from, size_t to) const { return String(_s.substr(from, to - from).c_str()); }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return (float)atof(_s.c_str()); }
+  bool startsWith(const String &prefix) const { return _s.rfind(prefix._s, 0) == 0; }
+  bool endsWith(const String &suffix) const
+  {
+    return _s.length() >= suffix.length() and
+           _s.compare(_s.length() - suffix.length(), suffix.length(), suffix._s) == 0;
+  }
+
+private:
+  std::string _s;
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+    {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const __FlashStringHelper *s) { return print(reinterpret_cast<const char *>(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  template <typename T>
+  size_t print(T value)
+  {
+    return print(String(value));
+  }
+  size_t println()
+  {
+    return write((uint8_t)'\n');
+  }
+  template <typename T>
+  size_t println(T value)
+  {
+    return print(value) + println();
+  }
+  size_t printf(const char *, ...) { return 0; }
+};
+
+class Printable
+{
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  size_t readBytes(uint8_t *, size_t) { return 0; }
+  size_t readBytes(char *, size_t) { return 0; }
+  String readStringUntil(char) { return String(); }
+};
+
+// Serial sink: accepts everything, emits nothing, so benchmark timings
+// are not dominated by trace output
+class MockSerial : public Print
+{
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+};
+static MockSerial Serial;
+
+class EspClass
+{
+public:
+  uint64_t getEfuseMac() { return 0x9C65F1D20C24ULL; }
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+  void restart() {}
+};
+static EspClass ESP;
+
+#endif
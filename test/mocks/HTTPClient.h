@@ -0,0 +1,67 @@
+#ifndef MOCK_HTTP_CLIENT_H
+#define MOCK_HTTP_CLIENT_H
+// Scriptable HTTPClient stand-in: every instance answers with the
+// class-wide canned response and records what was sent, so tests can
+// drive the whole transmit pipeline and assert on the traffic without
+// a network. State is static on purpose - the logger recreates its
+// HTTPClient after transport errors and the script must survive that.
+#include "Arduino.h"
+#include "WiFi.h"
+
+class HTTPClient
+{
+public:
+  // ---- test scripting ----
+  static inline int responseCode = 200;
+  static inline String responseBody = "{}";
+  static inline u32_t requestCount = 0;
+  static inline String lastUrl;
+  static inline String lastBody;
+  static void reset()
+  {
+    responseCode = 200;
+    responseBody = "{}";
+    requestCount = 0;
+    lastUrl = "";
+    lastBody = "";
+  }
+
+  // ---- API surface Logger.h uses ----
+  bool begin(const String &url)
+  {
+    lastUrl = url;
+    return true;
+  }
+  bool begin(WiFiClient &, const String &url)
+  {
+    lastUrl = url;
+    return true;
+  }
+  void addHeader(const String &, const String &) {}
+  void collectHeaders(const char *[], size_t) {}
+  String header(const char *) { return String(); }
+  int GET()
+  {
+    requestCount++;
+    return responseCode;
+  }
+  int POST(const String &payload)
+  {
+    requestCount++;
+    lastBody = payload;
+    return responseCode;
+  }
+  int POST(uint8_t *body, size_t length)
+  {
+    requestCount++;
+    lastBody = String((const char *)body, length);
+    return responseCode;
+  }
+  String getString() { return responseBody; }
+  int getSize() { return (int)responseBody.length(); }
+  WiFiClient *getStreamPtr() { return nullptr; }
+  void end() {}
+  void setReuse(bool) {}
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef MOCK_WIFI_H
+#define MOCK_WIFI_H
+// Host-side WiFi stand-in: always "connected" in station mode so the
+// logger's connectivity gates pass. WiFiClient sockets never connect;
+// paths that need a live stream (streamed mode, OTA) fail fast instead.
+#include "Arduino.h"
+
+enum wl_status_t
+{
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED
+};
+
+enum wifi_mode_t
+{
+  WIFI_OFF = 0,
+  WIFI_STA,
+  WIFI_AP,
+  WIFI_AP_STA
+};
+
+class WiFiClass
+{
+public:
+  wl_status_t status() { return WL_CONNECTED; }
+  wifi_mode_t getMode() { return WIFI_STA; }
+};
+static WiFiClass WiFi;
+
+class WiFiClient : public Stream
+{
+public:
+  virtual ~WiFiClient() {}
+  bool connect(const char *, uint16_t) { return false; }
+  bool connected() { return false; }
+  void stop() {}
+  void flush() {}
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+#endif
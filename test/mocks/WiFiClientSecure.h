@@ -0,0 +1,12 @@
+#ifndef MOCK_WIFI_CLIENT_SECURE_H
+#define MOCK_WIFI_CLIENT_SECURE_H
+#include "WiFi.h"
+
+class WiFiClientSecure : public WiFiClient
+{
+public:
+  void setInsecure() {}
+  void setCACert(const char *) {}
+};
+
+#endif
@@ -0,0 +1,170 @@
+// Host-native benchmarks for the logging pipeline (pio test -e native).
+// Times the hot paths - Sensor::run, batch serialization and a full
+// tick against the scripted HTTPClient - at several sensor counts, and
+// counts heap allocations through overridden operator new. The asserts
+// are deliberately loose sanity checks; the numbers in the output are
+// the point, tracked across commits rather than gated.
+#include <Arduino.h>
+#include <unity.h>
+#include <Logger.h>
+
+// ---- allocation counting ----
+static size_t gAllocCount = 0;
+static size_t gAllocBytes = 0;
+void *operator new(size_t size)
+{
+  gAllocCount++;
+  gAllocBytes += size;
+  return malloc(size);
+}
+void *operator new[](size_t size)
+{
+  gAllocCount++;
+  gAllocBytes += size;
+  return malloc(size);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static void resetAllocCounters()
+{
+  gAllocCount = 0;
+  gAllocBytes = 0;
+}
+
+static float benchCallback()
+{
+  static float value = 0;
+  value += 0.5f;
+  return value;
+}
+
+// Sensor::run/getJson are protected (friend ESPLogger); surface them
+// for direct benchmarking
+struct BenchSensor : Sensor
+{
+  BenchSensor() : Sensor("bench", "unit", "float", benchCallback) {}
+  void benchRun(u32_t timestamp) { run(timestamp); }
+  JsonDocument benchJson() { return getJson(); }
+  void benchClear() { clearReadings(); }
+};
+
+void setUp() {}
+void tearDown() {}
+
+// Cost of one scalar sample into the ring buffer
+static void test_sensor_run_bench()
+{
+  static BenchSensor sensor;
+  const int iterations = 100000;
+  u32_t started = micros();
+  for (int i = 0; i < iterations; i++)
+  {
+    sensor.benchRun(1700000000u + i);
+  }
+  u32_t elapsed = micros() - started;
+  char line[96];
+  snprintf(line, sizeof(line), "Sensor::run: %.3f us/sample (%d samples)",
+           (double)elapsed / iterations, iterations);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(sensor.lastReadDurationMicros() < 1000000u);
+}
+
+// Serialization of N full sensors into a JSON payload String
+template <int NumSensors>
+static void serializeBench()
+{
+  static BenchSensor sensors[NumSensors];
+  for (int i = 0; i < NumSensors; i++)
+  {
+    for (int r = 0; r < LOGGER_SENSOR_BUFFER_SIZE; r++)
+    {
+      sensors[i].benchRun(1700000000u + r);
+    }
+  }
+  resetAllocCounters();
+  u32_t started = micros();
+  JsonDocument doc;
+  JsonArray array = doc["sensors"].to<JsonArray>();
+  for (int i = 0; i < NumSensors; i++)
+  {
+    array.add(sensors[i].benchJson());
+  }
+  String payload;
+  serializeJson(doc, payload);
+  u32_t elapsed = micros() - started;
+  char line[128];
+  snprintf(line, sizeof(line),
+           "serialize %2d sensors x %d readings: %u us, %u bytes, %u allocs (%u B)",
+           NumSensors, LOGGER_SENSOR_BUFFER_SIZE, elapsed,
+           (unsigned)payload.length(), (unsigned)gAllocCount, (unsigned)gAllocBytes);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(payload.length() > 0);
+  for (int i = 0; i < NumSensors; i++)
+  {
+    sensors[i].benchClear();
+  }
+}
+
+// One full tick with a due batch: sample, serialize, POST against the
+// scripted HTTPClient, parse the response
+template <int NumSensors>
+static void tickBench()
+{
+  HTTPClient::reset();
+  HTTPClient::responseBody = "{\"unix_time\":\"1700000000\"}";
+  HTTPClient::responseCode = 200;
+  static ESPLogger<NumSensors> logger;
+  static Sensor sensors[NumSensors];
+  for (int i = 0; i < NumSensors; i++)
+  {
+    sensors[i] = Sensor("bench", "unit", "float", benchCallback);
+    logger.addSensor(sensors[i]);
+  }
+  TEST_ASSERT_TRUE(logger.init("bench-key"));
+  HTTPClient::responseCode = 201;
+  HTTPClient::responseBody = "{}";
+  u32_t requestsBefore = HTTPClient::requestCount;
+  // Make sampling and the log batch due, then run the pipeline
+  mockAdvanceMillis((logger.getLogInterval() + 1) * 1000);
+  resetAllocCounters();
+  u32_t started = micros();
+  bool delivered = logger.tick();
+  u32_t elapsed = micros() - started;
+  const LoggerMetrics &metrics = logger.getMetrics();
+  char line[160];
+  snprintf(line, sizeof(line),
+           "tick %2d sensors: %u us total (serialize %u us, post %u us), %u B payload, %u allocs",
+           NumSensors, elapsed, metrics.lastSerializeMicros, metrics.lastPostMicros,
+           (unsigned)metrics.lastPayloadBytes, (unsigned)gAllocCount);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(delivered);
+  TEST_ASSERT_TRUE(HTTPClient::requestCount > requestsBefore);
+  TEST_ASSERT_TRUE(HTTPClient::lastBody.length() > 0);
+}
+
+static void test_serialize_1() { serializeBench<1>(); }
+static void test_serialize_8() { serializeBench<8>(); }
+static void test_serialize_32() { serializeBench<32>(); }
+static void test_serialize_64() { serializeBench<64>(); }
+static void test_tick_1() { tickBench<1>(); }
+static void test_tick_8() { tickBench<8>(); }
+static void test_tick_32() { tickBench<32>(); }
+static void test_tick_64() { tickBench<64>(); }
+
+int main(int, char **)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_sensor_run_bench);
+  RUN_TEST(test_serialize_1);
+  RUN_TEST(test_serialize_8);
+  RUN_TEST(test_serialize_32);
+  RUN_TEST(test_serialize_64);
+  RUN_TEST(test_tick_1);
+  RUN_TEST(test_tick_8);
+  RUN_TEST(test_tick_32);
+  RUN_TEST(test_tick_64);
+  return UNITY_END();
+}